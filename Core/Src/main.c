@@ -32,6 +32,10 @@
 #include "player.h"
 #include "gui.h"
 #include "delay.h"
+#include "sd_spi_driver.h"
+#include "library.h"
+#include "playlist.h"
+#include "scheduler.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -41,6 +45,7 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+#define CYCLES_PER_US (SystemCoreClock / 1000000)
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -55,8 +60,10 @@ I2S_HandleTypeDef hi2s3;
 DMA_HandleTypeDef hdma_spi3_tx;
 
 SPI_HandleTypeDef hspi2;
+DMA_HandleTypeDef hdma_spi2_tx;
 
 TIM_HandleTypeDef htim6;
+TIM_HandleTypeDef htim7;
 
 /* USER CODE BEGIN PV */
 
@@ -70,6 +77,7 @@ static void MX_I2C1_Init(void);
 static void MX_I2S3_Init(void);
 static void MX_SPI2_Init(void);
 static void MX_TIM6_Init(void);
+static void MX_TIM7_Init(void);
 /* USER CODE BEGIN PFP */
 
 /* USER CODE END PFP */
@@ -79,6 +87,32 @@ static void MX_TIM6_Init(void);
 static void __attribute__((noreturn)) halt(void) {
 	while (1);
 }
+
+/* Main loop tasks. Refill has to be done before the other half of the buffer is played (~85ms at 48kHz),
+ * decoding takes a good part of that, so it's checked for before any other task is started. */
+static const scheduler_task_t tasks[] = {
+	{"audio", player_task, player_refill_pending, SCHEDULER_PRIORITY_AUDIO, 40000, 30000},
+	{"sd", sd_spi_driver_task, NULL, SCHEDULER_PRIORITY_IO, 1000, 0},
+	{"gui", gui_task, NULL, SCHEDULER_PRIORITY_UI, 10000, 0},
+	{"prefetch", gui_prefetch_task, NULL, SCHEDULER_PRIORITY_BACKGROUND, 5000, 0},
+	{"library", library_task, NULL, SCHEDULER_PRIORITY_BACKGROUND, 5000, 0}
+};
+
+static uint32_t get_cycles(void) {
+	return DWT->CYCCNT;
+}
+
+static void scheduler_config(void) {
+	/* Enable cycle counter, it's used to measure task run times */
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	scheduler_init(get_cycles, CYCLES_PER_US);
+	for (size_t i = 0; i < (sizeof(tasks) / sizeof(tasks[0])); ++i) {
+		scheduler_add(&tasks[i]);
+	}
+}
 /* USER CODE END 0 */
 
 /**
@@ -115,8 +149,11 @@ int main(void)
   MX_SPI2_Init();
   MX_FATFS_Init();
   MX_TIM6_Init();
+  MX_TIM7_Init();
   /* USER CODE BEGIN 2 */
   const char *const mount_point = "";
+
+  HD44780_io_init(&htim7);
   HD44780_config_t display_config = {
   		  .io = HD44780_get_io(),
   		  .type = HD44780_DISPLAY_20x2,
@@ -144,18 +181,21 @@ int main(void)
   }
 
   dir_init(mount_point);
+  library_init(mount_point);
+  playlist_init(mount_point);
   keyboard_init();
   display_init();
   player_init(&hi2s3, &hi2c1);
   gui_init();
+  scheduler_config();
 
   while (1) {
-	  gui_task();
-	  player_task();
+	  scheduler_run();
   }
 
   player_stop();
   gui_deinit();
+  library_deinit();
   display_deinit();
   f_mount(NULL, mount_point, 0);
   halt();
@@ -362,6 +402,48 @@ static void MX_TIM6_Init(void)
 
 }
 
+/**
+  * @brief TIM7 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_TIM7_Init(void)
+{
+
+  /* USER CODE BEGIN TIM7_Init 0 */
+
+  /* USER CODE END TIM7_Init 0 */
+
+  TIM_MasterConfigTypeDef sMasterConfig = {0};
+
+  /* USER CODE BEGIN TIM7_Init 1 */
+
+  /* USER CODE END TIM7_Init 1 */
+  htim7.Instance = TIM7;
+  htim7.Init.Prescaler = 54-1;
+  htim7.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim7.Init.Period = 65535;
+  htim7.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+  if (HAL_TIM_Base_Init(&htim7) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  if (HAL_TIM_OnePulse_Init(&htim7, TIM_OPMODE_SINGLE) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+  sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+  if (HAL_TIMEx_MasterConfigSynchronization(&htim7, &sMasterConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  /* USER CODE BEGIN TIM7_Init 2 */
+
+  /* USER CODE END TIM7_Init 2 */
+
+}
+
 /**
   * Enable DMA controller clock
   */
@@ -372,6 +454,9 @@ static void MX_DMA_Init(void)
   __HAL_RCC_DMA1_CLK_ENABLE();
 
   /* DMA interrupt init */
+  /* DMA1_Stream4_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Stream4_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream4_IRQn);
   /* DMA1_Stream5_IRQn interrupt configuration */
   HAL_NVIC_SetPriority(DMA1_Stream5_IRQn, 0, 0);
   HAL_NVIC_EnableIRQ(DMA1_Stream5_IRQn);
@@ -8,8 +8,9 @@
 #include "display.h"
 
 #include "HD44780.h"
+#include "fatfs.h"
 #include <string.h>
-#include <stdlib.h>
+#include <stdbool.h>
 #include <errno.h>
 #include "stm32f4xx_hal.h"
 
@@ -17,170 +18,276 @@
 #define DISPLAY_SUFFIX "  "
 #define DISPLAY_SUFFIX_LENGTH 2
 
-/* Custom glyphs */
-static const uint8_t pause_glyph[] = {
-	0b00000, 0b01010, 0b01010, 0b01010, 0b01010, 0b01010, 0b00000
-};
-static const uint8_t play_glyph[] = {
-	0b00000, 0b01000, 0b01100, 0b01110, 0b01100, 0b01000, 0b00000
+/* Longest text that can be displayed is the longest file name, longer ones get truncated */
+#define DISPLAY_TEXT_MAX_LENGTH _MAX_LFN
+
+/* Scrolled text is followed by the copy of its beginning, so that every window is contiguous */
+#define DISPLAY_BUFFER_SIZE (DISPLAY_TEXT_MAX_LENGTH + DISPLAY_SUFFIX_LENGTH + DISPLAY_LINE_LENGTH + 1)
+
+/* CGRAM is mirrored at codes 0x08-0x0F - unlike 0x00, all of them can be used in strings */
+#define DISPLAY_GLYPH_CODE_BASE 0x08
+#define DISPLAY_GLYPH_SLOTS HD44780_CUSTOM_GLYPHS_NUM
+
+/* Boundary cell of a bar, filled from the left with 1 to 4 columns */
+static const uint8_t bar_glyphs[DISPLAY_BAR_STEPS_PER_CELL - 1][DISPLAY_GLYPH_HEIGHT] = {
+	{0b10000, 0b10000, 0b10000, 0b10000, 0b10000, 0b10000, 0b10000, 0b10000},
+	{0b11000, 0b11000, 0b11000, 0b11000, 0b11000, 0b11000, 0b11000, 0b11000},
+	{0b11100, 0b11100, 0b11100, 0b11100, 0b11100, 0b11100, 0b11100, 0b11100},
+	{0b11110, 0b11110, 0b11110, 0b11110, 0b11110, 0b11110, 0b11110, 0b11110}
 };
 
 typedef struct {
-	char *line_buffer[DISPLAY_LINE_NUM];
-	size_t line_offset[DISPLAY_LINE_NUM];
-	uint32_t scroll_delay[DISPLAY_LINE_NUM];
-	uint32_t last_refresh_tick[DISPLAY_LINE_NUM];
+	uint8_t glyph[DISPLAY_GLYPH_HEIGHT];
+	bool loaded;
+	size_t refs;
+	uint32_t last_use; // Value of use counter when the glyph was last acquired
+} display_glyph_slot_t;
+
+typedef struct {
+	char buffer[DISPLAY_BUFFER_SIZE];
+	size_t length; // Length of the text with padding and suffix, without wrapped copy
+	bool scrolled;
+	size_t offset; // Window start for scrolled line, number of renders for static one
+	uint32_t scroll_delay;
+	uint32_t last_refresh_tick;
+} display_line_t;
+
+typedef struct {
+	display_line_t lines[DISPLAY_LINE_NUM];
+	char frame[DISPLAY_LINE_NUM][DISPLAY_LINE_LENGTH]; // What should be on the screen
+	char shadow[DISPLAY_LINE_NUM][DISPLAY_LINE_LENGTH]; // What controller's DDRAM holds
+	size_t cursor_line; // Position DDRAM address counter points to, DISPLAY_LINE_NUM if unknown
+	size_t cursor_column;
+	display_glyph_slot_t glyphs[DISPLAY_GLYPH_SLOTS];
+	uint32_t glyph_use_counter;
 } display_ctx_t;
 
 static display_ctx_t ctx;
 
+static size_t min(size_t a, size_t b) {
+	return (a < b) ? a : b;
+}
+
+/* Fills line with the text padded with spaces to given length. Text longer than
+ * display is scrolled, so suffix and wrapped copy of the beginning are added. */
+static void set_line(display_line_t *line, const char *text, size_t text_length, size_t padded_length, uint32_t scroll_delay) {
+	memcpy(line->buffer, text, text_length);
+	memset(&line->buffer[text_length], ' ', padded_length - text_length);
+
+	line->scrolled = (padded_length > DISPLAY_LINE_LENGTH);
+	if (line->scrolled) {
+		memcpy(&line->buffer[padded_length], DISPLAY_SUFFIX, DISPLAY_SUFFIX_LENGTH);
+		line->length = padded_length + DISPLAY_SUFFIX_LENGTH;
+		memcpy(&line->buffer[line->length], line->buffer, DISPLAY_LINE_LENGTH);
+		line->buffer[line->length + DISPLAY_LINE_LENGTH] = '\0';
+	}
+	else {
+		line->length = DISPLAY_LINE_LENGTH;
+		memset(&line->buffer[padded_length], ' ', DISPLAY_LINE_LENGTH - padded_length);
+		line->buffer[DISPLAY_LINE_LENGTH] = '\0';
+	}
+
+	line->scroll_delay = scroll_delay;
+	line->offset = 0;
+	line->last_refresh_tick = 0;
+}
+
+/* Sends only the cells that differ from what's already displayed. Address counter moves on by itself
+ * after each character, so cursor is set only when there's a gap between changed cells. */
+static void flush(void) {
+	for (size_t line = 0; line < DISPLAY_LINE_NUM; ++line) {
+		for (size_t column = 0; column < DISPLAY_LINE_LENGTH; ++column) {
+			if (ctx.frame[line][column] == ctx.shadow[line][column]) {
+				continue;
+			}
+
+			if ((ctx.cursor_line != line) || (ctx.cursor_column != column)) {
+				HD44780_gotoxy(line + 1, column + 1);
+				ctx.cursor_line = line;
+			}
+
+			HD44780_write_char(ctx.frame[line][column]);
+			ctx.shadow[line][column] = ctx.frame[line][column];
+			ctx.cursor_column = column + 1;
+		}
+	}
+}
+
 void display_init(void) {
 	memset(&ctx, 0, sizeof(display_ctx_t));
-	HD44780_load_custom_glyph(pause_glyph, DISPLAY_PAUSE_GLYPH);
-	HD44780_load_custom_glyph(play_glyph, DISPLAY_PLAY_GLYPH);
 	HD44780_clear();
+
+	/* Cleared display is filled with spaces, cursor is in the top left corner */
+	memset(ctx.frame, ' ', sizeof(ctx.frame));
+	memset(ctx.shadow, ' ', sizeof(ctx.shadow));
+	ctx.cursor_line = 0;
+	ctx.cursor_column = 0;
 }
 
 int display_set_text(const char *text, size_t line_num, uint32_t scroll_delay) {
-	if ((line_num < 1) || (line_num > DISPLAY_LINE_NUM)) {
+	if ((text == NULL) || (line_num < 1) || (line_num > DISPLAY_LINE_NUM)) {
 		return -EINVAL;
 	}
 
-	free(ctx.line_buffer[line_num - 1]);
+	const size_t length = min(strlen(text), DISPLAY_TEXT_MAX_LENGTH);
+	set_line(&ctx.lines[line_num - 1], text, length, length, scroll_delay);
 
-	const size_t line_length = strlen(text);
-	char *line;
-
-	/* Case without scrolling */
-	if (line_length <= DISPLAY_LINE_LENGTH) {
-		line = calloc(1, DISPLAY_LINE_LENGTH + 1);
-		if (line == NULL) {
-			return -ENOMEM;
-		}
-		memcpy(line, text, line_length);
+	return 0;
+}
 
-		const size_t padding = DISPLAY_LINE_LENGTH - line_length;
-		memset(&line[line_length], ' ', padding);
-		line[line_length + padding] = '\0';
+int display_set_text_sync(const char *first_line_text, const char *second_line_text, uint32_t scroll_delay) {
+	if ((first_line_text == NULL) || (second_line_text == NULL)) {
+		return -EINVAL;
 	}
-	else {
-		line = calloc(1, line_length + DISPLAY_SUFFIX_LENGTH + 1);
-		if (line == NULL) {
-			return -ENOMEM;
-		}
-		memcpy(line, text, line_length);
-		memcpy(&line[line_length], DISPLAY_SUFFIX, DISPLAY_SUFFIX_LENGTH + 1);
+
+	const size_t first_length = min(strlen(first_line_text), DISPLAY_TEXT_MAX_LENGTH);
+	const size_t second_length = min(strlen(second_line_text), DISPLAY_TEXT_MAX_LENGTH);
+
+	/* Line that fits is not scrolled */
+	if ((first_length <= DISPLAY_LINE_LENGTH) || (second_length <= DISPLAY_LINE_LENGTH)) {
+		set_line(&ctx.lines[0], first_line_text, first_length, first_length, scroll_delay);
+		set_line(&ctx.lines[1], second_line_text, second_length, second_length, scroll_delay);
+		return 0;
 	}
 
-	ctx.line_buffer[line_num - 1] = line;
-	ctx.scroll_delay[line_num - 1] = scroll_delay;
-	ctx.line_offset[line_num - 1] = 0;
-	ctx.last_refresh_tick[line_num - 1] = 0;
+	/* Both scrolled, pad the shorter one so that they scroll together */
+	const size_t max_length = (first_length > second_length) ? first_length : second_length;
+	set_line(&ctx.lines[0], first_line_text, first_length, max_length, scroll_delay);
+	set_line(&ctx.lines[1], second_line_text, second_length, max_length, scroll_delay);
 
 	return 0;
 }
 
-int display_set_text_sync(const char *first_line_text, const char *second_line_text, uint32_t scroll_delay) {
-	const size_t first_length = strlen(first_line_text);
-	const size_t second_length = strlen(second_line_text);
+int display_acquire_glyph(const uint8_t *glyph) {
+	display_glyph_slot_t *victim = NULL;
 
-	/* Fallback to regular text setting so that the line that fits is not scrolled */
-	if ((first_length <= DISPLAY_LINE_LENGTH) || (second_length <= DISPLAY_LINE_LENGTH)) {
-		int ret = display_set_text(first_line_text, 1, scroll_delay);
-		if (ret) {
-			return ret;
+	/* Sanity check */
+	if (glyph == NULL) {
+		return -EINVAL;
+	}
+
+	for (size_t i = 0; i < DISPLAY_GLYPH_SLOTS; ++i) {
+		display_glyph_slot_t *slot = &ctx.glyphs[i];
+
+		/* Already loaded, no need to touch CGRAM */
+		if (slot->loaded && (memcmp(slot->glyph, glyph, DISPLAY_GLYPH_HEIGHT) == 0)) {
+			slot->refs++;
+			slot->last_use = ++ctx.glyph_use_counter;
+			return DISPLAY_GLYPH_CODE_BASE + i;
+		}
+
+		/* Prefer free slot, then the least recently used unreferenced one */
+		if (slot->refs > 0) {
+			continue;
+		}
+		if ((victim == NULL) || (victim->loaded && (!slot->loaded || (slot->last_use < victim->last_use)))) {
+			victim = slot;
 		}
+	}
 
-		ret = display_set_text(second_line_text, 2, scroll_delay);
-		return ret;
+	if (victim == NULL) {
+		return -ENOSPC;
 	}
 
-	free(ctx.line_buffer[0]);
-	free(ctx.line_buffer[1]);
+	const size_t index = victim - ctx.glyphs;
+	HD44780_load_custom_glyph(glyph, index);
+	ctx.cursor_line = DISPLAY_LINE_NUM; // Address counter now points to CGRAM
 
-	const size_t max_length = (first_length > second_length) ? first_length : second_length;
+	memcpy(victim->glyph, glyph, DISPLAY_GLYPH_HEIGHT);
+	victim->loaded = true;
+	victim->refs = 1;
+	victim->last_use = ++ctx.glyph_use_counter;
 
-	char *first_line = calloc(1, max_length + DISPLAY_SUFFIX_LENGTH + 1);
-	if (first_line == NULL) {
-		return -ENOMEM;
-	}
+	return DISPLAY_GLYPH_CODE_BASE + index;
+}
 
-	char *second_line = calloc(1, max_length + DISPLAY_SUFFIX_LENGTH + 1);
-	if (second_line == NULL) {
-		free(first_line);
-		return -ENOMEM;
+void display_release_glyph(char code) {
+	const size_t index = (uint8_t)code - DISPLAY_GLYPH_CODE_BASE;
+	if ((index >= DISPLAY_GLYPH_SLOTS) || (ctx.glyphs[index].refs == 0)) {
+		return;
 	}
 
-	memcpy(first_line, first_line_text, first_length);
-	memcpy(second_line, second_line_text, second_length);
+	ctx.glyphs[index].refs--;
+}
 
-	const size_t padding = abs((long)first_length - (long)second_length);
-	if (first_length < second_length) {
-		memset(&first_line[first_length], ' ', padding);
+int display_render_bar(display_bar_t *bar, char *buffer, size_t cells, uint32_t value, uint32_t max) {
+	/* Sanity check */
+	if ((bar == NULL) || (buffer == NULL)) {
+		return -EINVAL;
 	}
-	else {
-		memset(&second_line[second_length], ' ', padding);
+
+	const uint32_t steps = cells * DISPLAY_BAR_STEPS_PER_CELL;
+	const uint32_t filled = (max > 0) ? (((uint64_t)min(value, max) * steps) / max) : 0;
+	const size_t full_cells = filled / DISPLAY_BAR_STEPS_PER_CELL;
+	const size_t partial_steps = filled % DISPLAY_BAR_STEPS_PER_CELL;
+	size_t position = full_cells;
+
+	memset(buffer, DISPLAY_BLOCK_GLYPH, full_cells);
+
+	/* New glyph is acquired before the old one is released, so the same one is never reloaded */
+	const char held_glyph = bar->glyph;
+	bar->glyph = '\0';
+	if (partial_steps > 0) {
+		const int code = display_acquire_glyph(bar_glyphs[partial_steps - 1]);
+		if (code >= 0) {
+			bar->glyph = code;
+		}
+		buffer[position++] = (code >= 0) ? code : ' ';
+	}
+	if (held_glyph != '\0') {
+		display_release_glyph(held_glyph);
 	}
 
-	memcpy(&first_line[max_length], DISPLAY_SUFFIX, DISPLAY_SUFFIX_LENGTH + 1);
-	memcpy(&second_line[max_length], DISPLAY_SUFFIX, DISPLAY_SUFFIX_LENGTH + 1);
+	memset(&buffer[position], ' ', cells - position);
+	buffer[cells] = '\0';
 
-	ctx.line_buffer[0] = first_line;
-	ctx.scroll_delay[0] = scroll_delay;
-	ctx.line_offset[0] = 0;
-	ctx.last_refresh_tick[0] = 0;
+	return 0;
+}
 
-	ctx.line_buffer[1] = second_line;
-	ctx.scroll_delay[1] = scroll_delay;
-	ctx.line_offset[1] = 0;
-	ctx.last_refresh_tick[1] = 0;
+void display_release_bar(display_bar_t *bar) {
+	if ((bar == NULL) || (bar->glyph == '\0')) {
+		return;
+	}
 
-	return 0;
+	display_release_glyph(bar->glyph);
+	bar->glyph = '\0';
 }
 
 void display_task(void) {
-	uint32_t current_tick = HAL_GetTick();
+	const uint32_t current_tick = HAL_GetTick();
 
 	for (size_t i = 0; i < DISPLAY_LINE_NUM; ++i) {
-		/* Skip if no line buffer or line empty */
-		if ((ctx.line_buffer[i] == NULL) || (ctx.line_buffer[i][0] == '\0')) {
+		display_line_t *line = &ctx.lines[i];
+
+		/* Skip if line was never set */
+		if (line->length == 0) {
 			continue;
 		}
 
+		if ((current_tick - line->last_refresh_tick) < line->scroll_delay) {
+			continue;
+		}
 
-		if ((current_tick - ctx.last_refresh_tick[i]) >= ctx.scroll_delay[i]) {
-			const size_t text_line_length = strlen(ctx.line_buffer[i]);
-
-			/* Display statically if it fits */
-			if (text_line_length <= DISPLAY_LINE_LENGTH) {
-				if (ctx.line_offset[i] > 0) {
-					continue;
-				}
-				HD44780_gotoxy(i + 1, 1);
-				HD44780_write_string(ctx.line_buffer[i]);
-				ctx.line_offset[i]++;
+		/* Display statically if it fits */
+		if (!line->scrolled) {
+			if (line->offset > 0) {
+				continue;
 			}
-			else {
-				/* Scroll if not */
-				char line_buffer[DISPLAY_LINE_LENGTH + 1];
-
-				for (size_t column = 0; column < DISPLAY_LINE_LENGTH; ++column) {
-					const size_t src_column = (ctx.line_offset[i] + column) % text_line_length;
-					line_buffer[column] = ctx.line_buffer[i][src_column];
-				}
-
-				HD44780_gotoxy(i + 1, 1);
-				HD44780_write_string(line_buffer);
+			memcpy(ctx.frame[i], line->buffer, DISPLAY_LINE_LENGTH);
+			line->offset++;
+		}
+		else {
+			/* Scroll if not */
+			memcpy(ctx.frame[i], &line->buffer[line->offset], DISPLAY_LINE_LENGTH);
 
-				ctx.line_offset[i]++;
-				ctx.last_refresh_tick[i] = current_tick;
-			}
+			line->offset = (line->offset + 1) % line->length;
+			line->last_refresh_tick = current_tick;
 		}
 	}
+
+	flush();
 }
 
-void display_cleanup(void) {
-	for (size_t i = 0; i < DISPLAY_LINE_NUM; ++i) {
-		free(ctx.line_buffer[i]);
-	}
+void display_deinit(void) {
+	memset(ctx.lines, 0, sizeof(ctx.lines));
 }
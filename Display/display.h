@@ -11,23 +11,42 @@
 #include <stddef.h>
 #include <stdint.h>
 
-/* Custom chars loaded to CGRAM in display_init(); address
- * 0x00 cannot be used because it's string null-terminator
- * in C, so I just picked the next one. */
-#define DISPLAY_PAUSE_GLYPH 0x01
-#define DISPLAY_PLAY_GLYPH 0x02
+/* Custom glyphs are 5x8 bitmaps, one byte per row, the last row is where cursor is shown */
+#define DISPLAY_GLYPH_HEIGHT 8
 
 /* From HD44780 charset */
 #define DISPLAY_BLOCK_GLYPH 0xFF
 
+/* Bar is drawn with resolution of a single column of glyph pixels */
+#define DISPLAY_BAR_STEPS_PER_CELL 5
+
 #define DISPLAY_LINE_NUM 2
 #define DISPLAY_LINE_LENGTH 20
 
+/* Horizontal bar, holds partially filled glyph of its boundary cell */
+typedef struct {
+	char glyph; // '\0' if none held
+} display_bar_t;
+
 void display_init(void);
 
 int display_set_text(const char *text, size_t line_num, uint32_t scroll_delay);
 int display_set_text_sync(const char *first_line_text, const char *second_line_text, uint32_t scroll_delay);
 
+/* Returns character code the glyph can be used in text with, loading it to CGRAM only if it's not there yet.
+ * Least recently used unreferenced glyph is replaced if there's no free slot, -ENOSPC if all are referenced. */
+int display_acquire_glyph(const uint8_t *glyph);
+
+/* Drops reference taken by display_acquire_glyph(), glyph stays loaded until its slot is needed */
+void display_release_glyph(char code);
+
+/* Fills buffer with bar of given number of cells showing value out of max, null-terminated. Full cells are
+ * ROM blocks and the boundary cell is one of partial glyphs, so consecutive values differ in a single cell. */
+int display_render_bar(display_bar_t *bar, char *buffer, size_t cells, uint32_t value, uint32_t max);
+
+/* Releases glyph held by the bar, has to be called once it's no longer displayed */
+void display_release_bar(display_bar_t *bar);
+
 void display_task(void);
 
 void display_deinit(void);
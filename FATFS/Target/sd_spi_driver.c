@@ -6,6 +6,7 @@
  */
 #include "sd_spi_driver.h"
 #include "stm32f4xx_hal.h"
+#include <string.h>
 
 /* MMC/SD command */
 #define CMD0	(0)			/* GO_IDLE_STATE */
@@ -42,6 +43,14 @@
 /* HAL SPI timeout */
 #define SPI_TIMEOUT 100 //ms
 
+/* Card busy timeout */
+#define MMC_BUSY_TIMEOUT 500 // ms
+
+/* Data tokens */
+#define MMC_TOKEN_START_BLOCK 0xFE // Single block read/write
+#define MMC_TOKEN_START_MULTI 0xFC // Multiple block write
+#define MMC_TOKEN_STOP_TRAN 0xFD // End of multiple block write
+
 /* Handle to SPI driver, defined in main.h */
 extern SPI_HandleTypeDef SD_SPI_HANDLE;
 
@@ -51,20 +60,48 @@ typedef enum {
 	SPI_CLOCK_FAST
 } spi_clock_t;
 
+/* Timer control functions */
+typedef struct {
+	uint32_t start_tick;
+	uint32_t delay_ms;
+} spi_timer_t;
+
+#if _USE_WRITE == 1
+/* Write-behind state machine states */
+typedef enum {
+	WRITE_IDLE, // No transaction in progress, staged blocks wait for start
+	WRITE_BLOCK_READY, // Waiting for card to accept next data block
+	WRITE_BLOCK_DMA, // Data block being clocked out by DMA
+	WRITE_STOP, // Waiting for card to accept StopTran token
+	WRITE_BUSY // Waiting for card to finish programming
+} write_state_t;
+
+/* Write-behind buffer - single run of consecutive sectors */
+typedef struct {
+	uint8_t buffer[SD_SPI_WRITE_BUFFER_BLOCKS][MMC_BLOCK_SIZE] __attribute__((aligned(4)));
+	DWORD sector; // First sector of staged run (LBA)
+	UINT count; // Number of staged blocks
+	UINT sent; // Number of blocks already sent to card
+	write_state_t state;
+	spi_timer_t timer;
+	volatile bool dma_done;
+	volatile bool dma_error;
+	bool error; // Sticky error, reported by next write or flush
+} write_ctx_t;
+#endif
+
 /* Driver context */
 typedef struct {
 	volatile DSTATUS status;
 	uint8_t card_type;
+	sd_spi_driver_stats_t stats;
+#if _USE_WRITE == 1
+	write_ctx_t write;
+#endif
 } spi_driver_t;
 
 static spi_driver_t ctx;
 
-/* Timer control functions */
-typedef struct {
-	uint32_t start_tick;
-	uint32_t delay_ms;
-} spi_timer_t;
-
 static void timer_start(spi_timer_t *timer, uint32_t delay_ms) {
 	timer->start_tick = HAL_GetTick();
 	timer->delay_ms = delay_ms;
@@ -99,14 +136,6 @@ static uint8_t spi_exchange_byte(uint8_t byte_to_send) {
 	return byte_received;
 }
 
-#if _USE_WRITE == 1
-static void spi_transmit(const uint8_t *buffer, size_t size) {
-	for (size_t i = 0; i < size; ++i) {
-		spi_exchange_byte(buffer[i]);
-	}
-}
-#endif
-
 static void spi_receive(uint8_t *buffer, size_t size) {
 	for (size_t i = 0; i < size; ++i) {
 		buffer[i] = spi_exchange_byte(0xFF);
@@ -178,37 +207,6 @@ static int mmc_receive_block(uint8_t *buffer, size_t block_size) {
 	return 1;
 }
 
-#if _USE_WRITE == 1
-static int mmc_transmit_block(const uint8_t *buffer, uint8_t token) {
-	uint8_t result;
-
-	/* Wait until card ready - 500ms */
-	if (spi_ready(500) == 0) {
-		return 0;
-	}
-
-	/* Send token */
-	spi_exchange_byte(token);
-
-	/* Send data if token is other than StopTran */
-	if (token != 0xFD) {
-		spi_transmit(buffer, MMC_BLOCK_SIZE);
-
-		/* Dummy CRC */
-		spi_exchange_byte(0xFF);
-		spi_exchange_byte(0xFF);
-
-		/* Check if data accepted */
-		result = spi_exchange_byte(0xFF);
-		if ((result & 0x1F) != 0x05) {
-			return 0;
-		}
-	}
-
-	return 1;
-}
-#endif
-
 static uint8_t mmc_transmit_command(uint8_t command, uint32_t argument) {
 	uint8_t response_bytes_count;
 	uint8_t result, crc;
@@ -271,6 +269,186 @@ static void mmc_read_ocr(uint8_t *ocr) {
 	}
 }
 
+#if _USE_WRITE == 1
+/* Write-behind control functions */
+static void write_abort(void) {
+	if (ctx.write.state == WRITE_BLOCK_DMA) {
+		HAL_SPI_Abort(&SD_SPI_HANDLE);
+	}
+	spi_deselect();
+
+	ctx.write.count = 0;
+	ctx.write.sent = 0;
+	ctx.write.state = WRITE_IDLE;
+	ctx.write.error = true;
+}
+
+static bool write_start(void) {
+	const uint8_t command = (ctx.write.count > 1) ? CMD25 : CMD24;
+	DWORD address = ctx.write.sector;
+
+	/* Convert LBA to BA addressing for byte-addressed cards */
+	if (!(ctx.card_type & TYPE_BLOCK)) {
+		address *= MMC_BLOCK_SIZE;
+	}
+
+	/* Predefine number of sectors, so that the card can pre-erase them */
+	if ((ctx.write.count > 1) && (ctx.card_type & TYPE_SDC)) {
+		mmc_transmit_command(ACMD23, ctx.write.count);
+	}
+
+	if (mmc_transmit_command(command, address) != 0) {
+		return false;
+	}
+
+	ctx.write.state = WRITE_BLOCK_READY;
+	timer_start(&ctx.write.timer, MMC_BUSY_TIMEOUT);
+	return true;
+}
+
+/* Checks card busy with a single byte exchange instead of spinning */
+static bool write_poll_ready(void) {
+	if (spi_exchange_byte(0xFF) == 0xFF) {
+		return true;
+	}
+
+	if (timer_timeout(&ctx.write.timer)) {
+		write_abort();
+	}
+	return false;
+}
+
+/* Performs one non-blocking step of the write state machine, returns true if any progress was made */
+static bool write_step(void) {
+	switch (ctx.write.state) {
+		case WRITE_IDLE:
+			if (ctx.write.count == 0) {
+				return false;
+			}
+			if (!write_start()) {
+				write_abort();
+			}
+			return true;
+
+		case WRITE_BLOCK_READY: {
+			if (!write_poll_ready()) {
+				return false;
+			}
+
+			const uint8_t token = (ctx.write.count > 1) ? MMC_TOKEN_START_MULTI : MMC_TOKEN_START_BLOCK;
+			spi_exchange_byte(token);
+
+			ctx.write.dma_done = false;
+			ctx.write.dma_error = false;
+			ctx.write.state = WRITE_BLOCK_DMA;
+			if (HAL_SPI_Transmit_DMA(&SD_SPI_HANDLE, ctx.write.buffer[ctx.write.sent], MMC_BLOCK_SIZE) != HAL_OK) {
+				write_abort();
+			}
+			return true;
+		}
+
+		case WRITE_BLOCK_DMA: {
+			if (ctx.write.dma_error) {
+				write_abort();
+				return true;
+			}
+			if (!ctx.write.dma_done) {
+				return false;
+			}
+
+			/* Dummy CRC */
+			spi_exchange_byte(0xFF);
+			spi_exchange_byte(0xFF);
+
+			/* Check if data accepted */
+			const uint8_t result = spi_exchange_byte(0xFF);
+			if ((result & 0x1F) != 0x05) {
+				write_abort();
+				return true;
+			}
+
+			ctx.write.sent++;
+			if (ctx.write.sent < ctx.write.count) {
+				ctx.write.state = WRITE_BLOCK_READY;
+			}
+			else {
+				ctx.write.state = (ctx.write.count > 1) ? WRITE_STOP : WRITE_BUSY;
+			}
+			timer_start(&ctx.write.timer, MMC_BUSY_TIMEOUT);
+			return true;
+		}
+
+		case WRITE_STOP:
+			if (!write_poll_ready()) {
+				return false;
+			}
+
+			spi_exchange_byte(MMC_TOKEN_STOP_TRAN);
+			ctx.write.state = WRITE_BUSY;
+			timer_start(&ctx.write.timer, MMC_BUSY_TIMEOUT);
+			return true;
+
+		case WRITE_BUSY:
+			if (!write_poll_ready()) {
+				return false;
+			}
+
+			spi_deselect();
+			ctx.write.count = 0;
+			ctx.write.sent = 0;
+			ctx.write.state = WRITE_IDLE;
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+static bool write_pending(void) {
+	return (ctx.write.state != WRITE_IDLE) || (ctx.write.count > 0);
+}
+
+/* Completes staged write, error of it stays latched until reported by write_barrier() */
+static void write_drain(void) {
+	while (write_pending()) {
+		write_step();
+	}
+}
+
+/* Blocks until all staged blocks are programmed, reports and clears sticky error */
+static DRESULT write_barrier(void) {
+	write_drain();
+
+	const bool error = ctx.write.error;
+	ctx.write.error = false;
+
+	return error ? RES_ERROR : RES_OK;
+}
+
+/* Checks if blocks can be appended to the staged run without restarting the transaction */
+static bool write_can_append(DWORD sector) {
+	if (ctx.write.count == 0) {
+		return true;
+	}
+
+	return (ctx.write.state == WRITE_IDLE) &&
+		   (ctx.write.sector + ctx.write.count == sector) &&
+		   (ctx.write.count < SD_SPI_WRITE_BUFFER_BLOCKS);
+}
+
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi) {
+	if (hspi == &SD_SPI_HANDLE) {
+		ctx.write.dma_done = true;
+	}
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi) {
+	if (hspi == &SD_SPI_HANDLE) {
+		ctx.write.dma_error = true;
+	}
+}
+#endif
+
 /* API functions */
 DSTATUS sd_spi_driver_init(BYTE pdrv) {
 	uint8_t ocr[4];
@@ -369,11 +547,20 @@ DRESULT sd_spi_driver_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count) {
 		return RES_NOTRDY;
 	}
 
+#if _USE_WRITE == 1
+	/* Bus and card have to be free, so complete pending writes first. Their error is left
+	 * for the next write or sync to report, reading doesn't change what's on the card. */
+	write_drain();
+#endif
+
 	/* Convert LBA to BA addressing for byte-addressed cards */
 	if (!(ctx.card_type & TYPE_BLOCK)) {
 		sector *= MMC_BLOCK_SIZE;
 	}
 
+	ctx.stats.read_commands++;
+	ctx.stats.read_sectors += count;
+
 	/* Single sector - READ_SINGLE_BLOCK command */
 	if (count == 1) {
 		if ((mmc_transmit_command(CMD17, sector) == 0) && (mmc_receive_block(buff, MMC_BLOCK_SIZE) != 0)) {
@@ -398,6 +585,14 @@ DRESULT sd_spi_driver_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count) {
 	return (count == 0) ? RES_OK : RES_ERROR;
 }
 
+void sd_spi_driver_get_stats(sd_spi_driver_stats_t *stats) {
+	*stats = ctx.stats;
+}
+
+void sd_spi_driver_reset_stats(void) {
+	memset(&ctx.stats, 0, sizeof(sd_spi_driver_stats_t));
+}
+
 #if _USE_WRITE == 1
 DRESULT sd_spi_driver_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count) {
 	/* Sanity check */
@@ -415,45 +610,56 @@ DRESULT sd_spi_driver_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT coun
 		return RES_WRPRT;
 	}
 
-	/* Convert LBA to BA addressing for byte-addressed cards */
-	if (!(ctx.card_type & TYPE_BLOCK)) {
-		sector *= MMC_BLOCK_SIZE;
+	/* Report error of previously staged write */
+	if (ctx.write.error) {
+		ctx.write.error = false;
+		return RES_ERROR;
 	}
 
-	/* Single sector - WRITE_BLOCK command */
-	if (count == 1) {
-		if ((mmc_transmit_command(CMD24, sector) == 0) && (mmc_transmit_block(buff, 0xFE) != 0)) {
-			count = 0;
+	/* Stage blocks in write-behind buffer, they will be sent by sd_spi_driver_task() */
+	while (count > 0) {
+		if (!write_can_append(sector)) {
+			if (write_barrier() != RES_OK) {
+				return RES_ERROR;
+			}
 		}
-	}
-	/* Multiple sectors */
-	else {
-		if (ctx.card_type & TYPE_SDC) {
-			mmc_transmit_command(ACMD23, count); // Predefine number of sectors
+
+		if (ctx.write.count == 0) {
+			ctx.write.sector = sector;
 		}
 
-		/* WRITE_MULTIPLE_BLOCK command */
-		if (mmc_transmit_command(CMD25, sector) == 0) {
-			while (count > 0) {
-				if (mmc_transmit_block(buff, 0xFC) == 0) {
-					break;
-				}
-				buff += MMC_BLOCK_SIZE;
-				--count;
-			}
+		memcpy(ctx.write.buffer[ctx.write.count], buff, MMC_BLOCK_SIZE);
+		ctx.write.count++;
 
-			/* STOP_TRAN token */
-			if (mmc_transmit_block(NULL, 0xFD) == 0) {
-				count = 1;
-			}
-		}
+		buff += MMC_BLOCK_SIZE;
+		sector++;
+		count--;
 	}
-	spi_deselect();
 
-	return (count == 0) ? RES_OK : RES_ERROR;
+	return RES_OK;
+}
+
+DRESULT sd_spi_driver_flush(void) {
+	return write_barrier();
+}
+
+bool sd_spi_driver_write_pending(void) {
+	return write_pending();
 }
 #endif
 
+void sd_spi_driver_task(void) {
+#if _USE_WRITE == 1
+	/* Not initialized */
+	if (ctx.status & STA_NOINIT) {
+		return;
+	}
+
+	/* Advance as far as possible without waiting for the card */
+	while (write_step());
+#endif
+}
+
 #if _USE_IOCTL == 1
 DRESULT sd_spi_driver_ioctl(BYTE pdrv, BYTE cmd, void *buff) {
 	DRESULT result;
@@ -470,6 +676,18 @@ DRESULT sd_spi_driver_ioctl(BYTE pdrv, BYTE cmd, void *buff) {
 		return RES_NOTRDY;
 	}
 
+#if _USE_WRITE == 1
+	/* Bus and card have to be free, staged data has to be on media for CTRL_SYNC, which reports its error */
+	if (cmd == CTRL_SYNC) {
+		if (write_barrier() != RES_OK) {
+			return RES_ERROR;
+		}
+	}
+	else {
+		write_drain();
+	}
+#endif
+
 	result = RES_ERROR;
 
 	switch (cmd) {
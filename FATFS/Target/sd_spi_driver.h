@@ -11,17 +11,39 @@
 #include "integer.h"
 #include "diskio.h"
 #include "ff_gen_drv.h"
+#include <stdbool.h>
+
+/* Number of blocks staged in write-behind buffer before writes start to block */
+#define SD_SPI_WRITE_BUFFER_BLOCKS 8
+
+/* Read path statistics, used to measure how many sectors are fetched per command */
+typedef struct {
+	uint32_t read_commands; // Number of CMD17/CMD18 issued
+	uint32_t read_sectors; // Number of sectors transferred by them
+} sd_spi_driver_stats_t;
 
 DSTATUS sd_spi_driver_init(BYTE pdrv);
 DSTATUS sd_spi_driver_status(BYTE pdrv);
 DRESULT sd_spi_driver_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count);
 
 #if _USE_WRITE == 1
+/* Writes are staged in write-behind buffer and sent with DMA from sd_spi_driver_task() */
 DRESULT sd_spi_driver_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count);
+
+/* Barrier - blocks until all staged writes are programmed into the card */
+DRESULT sd_spi_driver_flush(void);
+
+bool sd_spi_driver_write_pending(void);
 #endif
 
 #if _USE_IOCTL == 1
 DRESULT sd_spi_driver_ioctl(BYTE pdrv, BYTE cmd, void *buff);
 #endif
 
+/* Advances pending writes without waiting for the card, to be called from main loop */
+void sd_spi_driver_task(void);
+
+void sd_spi_driver_get_stats(sd_spi_driver_stats_t *stats);
+void sd_spi_driver_reset_stats(void);
+
 #endif /* TARGET_SD_SPI_DRIVER_H_ */
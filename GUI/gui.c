@@ -10,6 +10,11 @@
 #include "display.h"
 #include "dir.h"
 #include "player.h"
+#include "library.h"
+#include "playlist.h"
+#include "queue.h"
+#include "spectrum.h"
+#include "scheduler.h"
 #include <string.h>
 #include <stdio.h>
 
@@ -17,31 +22,77 @@
 #define GUI_FRAMES_TO_ANALYZE_BITRATE 5
 #define GUI_MINS_PER_HOUR 60
 #define GUI_PLAYBACK_REFRESH_INTERVAL 250 // ms
+/* About 25 frames per second. Spectrum update takes about 5 us on PC (Tools/benchmarks), even a hundred times
+ * that on the device is a small part of GUI task budget, so redraws don't get near the refill deadline. */
+#define GUI_SPECTRUM_REFRESH_INTERVAL 40 // ms
+#define GUI_SPECTRUM_GLYPHS (DISPLAY_GLYPH_HEIGHT - 1) // Cells filled from the bottom with 1 to 7 rows, full one is ROM block
+#define GUI_STATS_PERIOD 60000 // ms
 #define GUI_VOLUME_VIEW_DISPLAY_TIME 2000 // ms
+#define GUI_PREFETCH_DELAY 300 // ms, cursor has to rest on directory that long to have it prefetched
+#define GUI_RETURN_STACK_DEPTH 8 // Levels of directories whose cursor position is restored on return
+#define GUI_JUMP_PREFIX_LENGTH 8
+#define GUI_JUMP_CHARSET "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"
 
 #define KBITS_TO_BYTES(x) ((1000 * (x)) / 8)
 
+/* Custom glyphs */
+static const uint8_t pause_glyph[DISPLAY_GLYPH_HEIGHT] = {
+	0b00000, 0b01010, 0b01010, 0b01010, 0b01010, 0b01010, 0b00000, 0b00000
+};
+static const uint8_t play_glyph[DISPLAY_GLYPH_HEIGHT] = {
+	0b00000, 0b01000, 0b01100, 0b01110, 0b01100, 0b01000, 0b00000, 0b00000
+};
+
 typedef enum {
 	GUI_VIEW_EXPLORER,
 	GUI_VIEW_PLAYBACK,
-	GUI_VIEW_VOLUME
+	GUI_VIEW_VOLUME,
+	GUI_VIEW_JUMP
 } gui_view_t;
 
 typedef enum {
-	GUI_REFRESH_ALL,
-	GUI_REFRESH_TIME
-} gui_refresh_t;
+	GUI_PLAYBACK_TIME,
+	GUI_PLAYBACK_PROGRESS,
+	GUI_PLAYBACK_SPECTRUM,
+	GUI_PLAYBACK_MODES_NUM
+} gui_playback_mode_t;
+
+/* Parts of a view rendered separately, set in dirty mask when they have to be redrawn */
+typedef enum {
+	GUI_WIDGET_TITLE = (1 << 0), // Top line
+	GUI_WIDGET_STATUS = (1 << 1), // Bottom line
+	GUI_WIDGET_ALL = (GUI_WIDGET_TITLE | GUI_WIDGET_STATUS)
+} gui_widget_t;
 
 typedef struct {
 	gui_view_t view;
 	dir_list_t *dirs;
-	dir_entry_t *current_dir;
-	dir_entry_t *last_playback_dir; // Stores entry that was played before leaving to explorer view
-	uint32_t last_refresh_tick; // Used to periodically refresh playback view
+	dir_entry_t current_dir;
+	uint8_t dirty_widgets; // Widgets of current view to be redrawn
+	uint32_t last_refresh_tick; // Used to sample bitrate and to refresh spectrum
+	uint32_t elapsed_time; // Values shown in playback view, widgets are invalidated when they change
+	int32_t total_time;
+	player_state_t player_state;
 	int8_t volume;
 	uint32_t last_volume_tick; // Used to return from volume view
 	uint32_t last_bitrate; // Used to determine whether current song is VBR
 	uint32_t frames_analyzed; // Frames analyzed by VBR detector
+	uint32_t last_explorer_tick; // Used to detect that cursor rests on an entry
+	dir_entry_t prefetched_dir; // Entry prefetch was last attempted for
+	dir_entry_t return_stack[GUI_RETURN_STACK_DEPTH]; // Cursor positions in parent directories
+	size_t dir_depth;
+	char jump_prefix[GUI_JUMP_PREFIX_LENGTH + 1]; // Typed beginning of the name to jump to
+	size_t jump_length;
+	dir_entry_t jump_entry; // Entry found for the prefix
+	char state_glyph; // Play or pause glyph held while playback view is shown, '\0' if none
+	display_bar_t bar; // Volume or playback progress bar
+	gui_playback_mode_t playback_mode; // What playback view shows besides the title
+	char spectrum_glyphs[GUI_SPECTRUM_GLYPHS]; // Held while spectrum is shown, '\0' if not loaded
+	uint8_t spectrum_levels[SPECTRUM_BANDS];
+	gui_stats_t stats;
+	bool status_rendered; // Status line of playback view rendered since last refresh interval
+	uint32_t last_stats_tick;
+	uint32_t stats_period_start; // Renders avoided at the beginning of current period
 } gui_ctx_t;
 
 static gui_ctx_t ctx;
@@ -51,12 +102,17 @@ static int32_t clamp(int32_t val, int32_t min, int32_t max) {
 	return (val > max) ? max : (val < min) ? min : val;
 }
 
-static int32_t map(int32_t x, int32_t in_min, int32_t in_max, int32_t out_min, int32_t out_max) {
-	return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+static void invalidate(uint8_t widgets) {
+	ctx.dirty_widgets |= widgets;
+}
+
+static void switch_view(gui_view_t view) {
+	ctx.view = view;
+	invalidate(GUI_WIDGET_ALL);
 }
 
-static bool is_directory(const FILINFO *fno) {
-	return fno->fattrib & AM_DIR;
+static bool is_directory(const dir_info_t *info) {
+	return info->attrib & AM_DIR;
 }
 
 static uint32_t get_elapsed_time(void) {
@@ -79,115 +135,320 @@ static int32_t get_total_time(size_t file_size) {
 	return file_size / KBITS_TO_BYTES(current_bitrate);
 }
 
+/* Replaces glyph held in given place with another one. New one is acquired first, so the same glyph is never
+ * reloaded. Returns its code or fallback character if there's no free CGRAM slot. */
+static char hold_glyph(char *held, const uint8_t *glyph, char fallback) {
+	const int code = display_acquire_glyph(glyph);
+
+	if (*held != '\0') {
+		display_release_glyph(*held);
+	}
+	*held = (code >= 0) ? code : '\0';
+
+	return (code >= 0) ? code : fallback;
+}
+
+static void release_glyph(char *held) {
+	if (*held != '\0') {
+		display_release_glyph(*held);
+		*held = '\0';
+	}
+}
+
+static void hold_spectrum_glyphs(void) {
+	for (size_t i = 0; i < GUI_SPECTRUM_GLYPHS; ++i) {
+		if (ctx.spectrum_glyphs[i] != '\0') {
+			continue;
+		}
+
+		uint8_t glyph[DISPLAY_GLYPH_HEIGHT];
+		for (size_t row = 0; row < DISPLAY_GLYPH_HEIGHT; ++row) {
+			glyph[row] = (row < (DISPLAY_GLYPH_HEIGHT - (i + 1))) ? 0b00000 : 0b11111;
+		}
+
+		const int code = display_acquire_glyph(glyph);
+		ctx.spectrum_glyphs[i] = (code >= 0) ? code : '\0';
+	}
+}
+
+static void release_spectrum_glyphs(void) {
+	for (size_t i = 0; i < GUI_SPECTRUM_GLYPHS; ++i) {
+		release_glyph(&ctx.spectrum_glyphs[i]);
+	}
+}
+
+/* Views without graphics don't need any glyphs */
+static void release_view_glyphs(void) {
+	release_glyph(&ctx.state_glyph);
+	display_release_bar(&ctx.bar);
+	release_spectrum_glyphs();
+}
+
 static void refresh_list(void) {
 	dir_list_free(ctx.dirs);
 	ctx.dirs = dir_list();
-	ctx.current_dir = ctx.dirs->head;
+	ctx.current_dir = (dir_list_size(ctx.dirs) > 0) ? 0 : DIR_ENTRY_INVALID;
+	ctx.prefetched_dir = DIR_ENTRY_INVALID;
+}
+
+static void change_dir(void) {
+	/* Keep listing of the directory being left, it's likely to be visited again soon */
+	dir_list_retain(ctx.dirs);
+	ctx.dirs = NULL;
+	refresh_list();
 }
 
-void start_playback(const char *filename) {
-	const char *const fs_path = dir_get_fs_path();
-	const size_t path_length = strlen(fs_path) + strlen(filename) + 2; // Additional '/' and null-teminator
+/* Let the player open the next track while the current one is being played */
+static void on_track_started(void) {
+	ctx.frames_analyzed = 0;
+	ctx.last_bitrate = player_get_mp3_frame_bitrate();
+	ctx.total_time = 0;
+	ctx.elapsed_time = 0;
+	ctx.player_state = player_get_state();
+	if (ctx.view == GUI_VIEW_PLAYBACK) {
+		invalidate(GUI_WIDGET_ALL);
+	}
 
-	char *path = calloc(1, path_length);
-	if (path == NULL) {
+	const queue_track_t *next = queue_get_next();
+	if ((next != NULL) && (player_get_state() == PLAYER_PLAYING)) {
+		player_prepare_next(next->path);
+	}
+}
+
+static void start_playback(void) {
+	const queue_track_t *track = queue_get_current();
+	if (track == NULL) {
 		return;
 	}
-	snprintf(path, path_length, "%s/%s", fs_path, filename);
 
-	player_start(path);
+	player_start(track->path);
 	player_set_volume(ctx.volume);
-	ctx.frames_analyzed = 0;
-	ctx.last_bitrate = player_get_mp3_frame_bitrate();
+	on_track_started();
+}
+
+/* Shuffles whole library when in root directory and the library is ready, current directory otherwise */
+static int start_shuffle(void) {
+	/* New order every time, time of button press is random enough */
+	const uint32_t seed = HAL_GetTick();
 
-	free(path);
+	if ((ctx.dir_depth == 0) && (library_get_state() == LIBRARY_READY)) {
+		return queue_shuffle_library(seed);
+	}
+	return queue_shuffle_dir(dir_get_fs_path(), seed);
 }
 
 static void render_view_explorer(void) {
+	ctx.last_explorer_tick = HAL_GetTick();
+	release_view_glyphs();
+
 	/* Empty directory case */
-	if (ctx.current_dir == NULL) {
+	if (ctx.current_dir == DIR_ENTRY_INVALID) {
 		display_set_text_sync("Directory is empty!", "", GUI_SCROLL_DELAY);
 		return;
 	}
 
-	const dir_entry_t *next_dir = dir_get_next(ctx.dirs, ctx.current_dir);
-	const FILINFO *fno1 = (FILINFO *)ctx.current_dir->data;
-	const FILINFO *fno2 = (FILINFO *)next_dir->data;
+	const dir_entry_t next_dir = dir_get_next(ctx.dirs, ctx.current_dir);
+	const dir_info_t *info1 = dir_get_info(ctx.dirs, ctx.current_dir);
+	const dir_info_t *info2 = dir_get_info(ctx.dirs, next_dir);
+
+	if ((info1 == NULL) || (info2 == NULL)) {
+		display_set_text_sync("Error: failed to", "read directory!", GUI_SCROLL_DELAY);
+		return;
+	}
 
 	/* One element case */
-	if (fno1 == fno2) {
-		display_set_text_sync(fno1->fname, "", GUI_SCROLL_DELAY);
+	if (next_dir == ctx.current_dir) {
+		display_set_text_sync(info1->name, "", GUI_SCROLL_DELAY);
 		return;
 	}
 
-	display_set_text_sync(fno1->fname, fno2->fname, GUI_SCROLL_DELAY);
+	display_set_text_sync(info1->name, info2->name, GUI_SCROLL_DELAY);
 }
 
-static void render_view_playback(gui_refresh_t refresh_mode) {
-	const FILINFO *fno = (FILINFO *)ctx.current_dir->data;
+/* Gets character showing given part, from 0 to DISPLAY_GLYPH_HEIGHT rows, of a spectrum bar */
+static char spectrum_char(int32_t rows) {
+	if (rows <= 0) {
+		return ' ';
+	}
+	if (rows >= DISPLAY_GLYPH_HEIGHT) {
+		return DISPLAY_BLOCK_GLYPH;
+	}
 
-	/* Compute elapsed and total time */
-	const uint32_t elapsed_time = get_elapsed_time();
-	const int32_t total_time = get_total_time(fno->fsize);
+	/* Glyph couldn't be loaded, round down */
+	const char code = ctx.spectrum_glyphs[rows - 1];
+	return (code != '\0') ? code : ' ';
+}
 
+/* Bars span both lines, so the view has twice as many levels as a single glyph */
+static void render_view_spectrum(void) {
+	char first_line[DISPLAY_LINE_LENGTH + 1];
+	char second_line[DISPLAY_LINE_LENGTH + 1];
 
-	/* Prepare bottom line of the view in buffer */
-	size_t offset;
-	char line_buffer[DISPLAY_LINE_LENGTH + 1];
-	const char state_char = (player_get_state() == PLAYER_PLAYING) ? DISPLAY_PLAY_GLYPH : DISPLAY_PAUSE_GLYPH;
+	release_glyph(&ctx.state_glyph);
+	display_release_bar(&ctx.bar);
+	hold_spectrum_glyphs();
 
-	offset = snprintf(line_buffer, sizeof(line_buffer), "%c   %02lu:%02lu", state_char, elapsed_time / GUI_MINS_PER_HOUR, elapsed_time % GUI_MINS_PER_HOUR);
+	/* Analyze what is about to be heard, bars only fall if nothing is played */
+	size_t position;
+	const int16_t *output = player_get_output(&position);
+	spectrum_update(ctx.spectrum_levels, output, PLAYER_BUFFER_SIZE_FRAMES, position);
 
-	if (total_time > 0) {
-		snprintf(&line_buffer[offset], sizeof(line_buffer) - offset, "/%02lu:%02lu", total_time / GUI_MINS_PER_HOUR, total_time % GUI_MINS_PER_HOUR);
+	for (size_t i = 0; i < DISPLAY_LINE_LENGTH; ++i) {
+		const uint8_t level = ctx.spectrum_levels[(i * SPECTRUM_BANDS) / DISPLAY_LINE_LENGTH];
+		first_line[i] = spectrum_char(level - DISPLAY_GLYPH_HEIGHT);
+		second_line[i] = spectrum_char(level);
 	}
-	else if (total_time == GUI_BITRATE_VBR) {
-		snprintf(&line_buffer[offset], sizeof(line_buffer) - offset, "/VBR");
+	first_line[DISPLAY_LINE_LENGTH] = '\0';
+	second_line[DISPLAY_LINE_LENGTH] = '\0';
+
+	display_set_text_sync(first_line, second_line, GUI_SCROLL_DELAY);
+}
+
+static void render_view_playback(uint8_t widgets) {
+	const queue_track_t *track = queue_get_current();
+	if (track == NULL) {
+		return;
 	}
 
-	switch (refresh_mode) {
-		case GUI_REFRESH_ALL:
-			display_set_text_sync(fno->fname, line_buffer, GUI_SCROLL_DELAY);
-			break;
+	const uint32_t elapsed_time = ctx.elapsed_time;
+	const int32_t total_time = ctx.total_time;
 
-		case GUI_REFRESH_TIME:
-			display_set_text(line_buffer, 2, GUI_SCROLL_DELAY);
-			break;
+	if (ctx.playback_mode == GUI_PLAYBACK_SPECTRUM) {
+		render_view_spectrum();
+		return;
+	}
+	release_spectrum_glyphs();
 
-		default:
-			break;
+	/* Prepare bottom line of the view in buffer */
+	char line_buffer[DISPLAY_LINE_LENGTH + 1];
+
+	/* Progress bar can be drawn only when total time is known, consecutive positions differ in one cell */
+	if ((ctx.playback_mode == GUI_PLAYBACK_PROGRESS) && (total_time > 0)) {
+		release_glyph(&ctx.state_glyph);
+		display_render_bar(&ctx.bar, line_buffer, DISPLAY_LINE_LENGTH, (uint32_t)player_get_frames_played(), total_time * player_get_pcm_sample_rate());
+	}
+	else {
+		const bool playing = (ctx.player_state == PLAYER_PLAYING);
+		const char state_char = hold_glyph(&ctx.state_glyph, playing ? play_glyph : pause_glyph, playing ? '>' : '|');
+		display_release_bar(&ctx.bar);
+
+		const size_t offset = snprintf(line_buffer, sizeof(line_buffer), "%c   %02lu:%02lu", state_char, elapsed_time / GUI_MINS_PER_HOUR, elapsed_time % GUI_MINS_PER_HOUR);
+
+		if (total_time > 0) {
+			snprintf(&line_buffer[offset], sizeof(line_buffer) - offset, "/%02lu:%02lu", total_time / GUI_MINS_PER_HOUR, total_time % GUI_MINS_PER_HOUR);
+		}
+		else if (total_time == GUI_BITRATE_VBR) {
+			snprintf(&line_buffer[offset], sizeof(line_buffer) - offset, "/VBR");
+		}
 	}
+
+	/* Title changes only along with the track, status has to be rendered then too */
+	if (widgets & GUI_WIDGET_TITLE) {
+		display_set_text_sync(track->name, line_buffer, GUI_SCROLL_DELAY);
+	}
+	else {
+		display_set_text(line_buffer, 2, GUI_SCROLL_DELAY);
+	}
+	ctx.status_rendered = true;
 }
 
 static void render_view_volume(void) {
-	const uint8_t volume_bar_length = map(ctx.volume, GUI_MIN_VOLUME, GUI_MAX_VOLUME, 1, DISPLAY_LINE_LENGTH);
 	const int8_t volume_db = ctx.volume / CS43L22_VOLUME_STEPS_PER_DB;
 
 	char first_line[DISPLAY_LINE_LENGTH + 1];
 	snprintf(first_line, sizeof(first_line), "Volume level: %ddB", volume_db);
 
 	char second_line[DISPLAY_LINE_LENGTH + 1];
-	memset(second_line, DISPLAY_BLOCK_GLYPH, volume_bar_length);
-	second_line[volume_bar_length] = '\0';
+	display_render_bar(&ctx.bar, second_line, DISPLAY_LINE_LENGTH, ctx.volume - GUI_MIN_VOLUME, GUI_MAX_VOLUME - GUI_MIN_VOLUME);
 
+	release_glyph(&ctx.state_glyph);
+	release_spectrum_glyphs();
 	display_set_text_sync(first_line, second_line, GUI_SCROLL_DELAY);
+}
+
+static void render_view_jump(void) {
+	char first_line[DISPLAY_LINE_LENGTH + 1];
+	snprintf(first_line, sizeof(first_line), "Jump to: %s", ctx.jump_prefix);
+
+	const dir_info_t *info = dir_get_info(ctx.dirs, ctx.jump_entry);
+	release_view_glyphs();
+	display_set_text_sync(first_line, (info != NULL) ? info->name : "", GUI_SCROLL_DELAY);
+}
+
+/* Returns charset character the name character maps to, '\0' if there's no such */
+static char jump_char(char c) {
+	if ((c >= 'a') && (c <= 'z')) {
+		c = c - 'a' + 'A';
+	}
+	return ((c != '\0') && (strchr(GUI_JUMP_CHARSET, c) != NULL)) ? c : '\0';
+}
+
+/* Appends character to the prefix - the one following the prefix in entry found so far, if possible */
+static void jump_append(void) {
+	if (ctx.jump_length == GUI_JUMP_PREFIX_LENGTH) {
+		return;
+	}
+
+	char c = GUI_JUMP_CHARSET[0];
+	const dir_info_t *info = dir_get_info(ctx.dirs, ctx.jump_entry);
+	if ((info != NULL) && (strlen(info->name) > ctx.jump_length) && (jump_char(info->name[ctx.jump_length]) != '\0')) {
+		c = jump_char(info->name[ctx.jump_length]);
+	}
+
+	ctx.jump_prefix[ctx.jump_length++] = c;
+	ctx.jump_prefix[ctx.jump_length] = '\0';
+	ctx.jump_entry = dir_find(ctx.dirs, ctx.jump_prefix);
+}
+
+/* Replaces last character of the prefix with previous or next one from the charset */
+static void jump_cycle(bool forward) {
+	const size_t charset_length = strlen(GUI_JUMP_CHARSET);
+	char *last = &ctx.jump_prefix[ctx.jump_length - 1];
+	size_t index = strchr(GUI_JUMP_CHARSET, *last) - GUI_JUMP_CHARSET;
+
+	index = forward ? ((index + 1) % charset_length) : ((index + charset_length - 1) % charset_length);
+	*last = GUI_JUMP_CHARSET[index];
+	ctx.jump_entry = dir_find(ctx.dirs, ctx.jump_prefix);
+}
 
+/* Plays previous or next track from the queue */
+static void play_adjacent(bool forward) {
+	if (queue_skip(forward) == 0) {
+		start_playback();
+	}
+}
+
+/* Switches to playback view if the queue was started */
+static void show_playback(int ret) {
+	if (ret == 0) {
+		start_playback();
+		switch_view(GUI_VIEW_PLAYBACK);
+	}
+}
+
+/* Volume view is shown for a while after each change */
+static void change_volume(int8_t step) {
+	ctx.volume = clamp(ctx.volume + step, GUI_MIN_VOLUME, GUI_MAX_VOLUME);
+	player_set_volume(ctx.volume);
 	ctx.last_volume_tick = HAL_GetTick();
+	switch_view(GUI_VIEW_VOLUME);
 }
 
 static void callback_up(void) {
 	switch (ctx.view) {
 		case GUI_VIEW_EXPLORER:
 			ctx.current_dir = dir_get_prev(ctx.dirs, ctx.current_dir);
-			render_view_explorer();
+			invalidate(GUI_WIDGET_ALL);
 			break;
 
-		case GUI_VIEW_PLAYBACK: {
-			ctx.current_dir = dir_get_prev(ctx.dirs, ctx.current_dir);
-			const FILINFO *fno = (FILINFO *)ctx.current_dir->data;
-			start_playback(fno->fname);
-			render_view_playback(GUI_REFRESH_ALL);
-		} break;
+		case GUI_VIEW_PLAYBACK:
+			play_adjacent(false);
+			break;
+
+		case GUI_VIEW_JUMP:
+			jump_cycle(false);
+			invalidate(GUI_WIDGET_ALL);
+			break;
 
 		default:
 			break;
@@ -198,15 +459,17 @@ static void callback_down(void) {
 	switch (ctx.view) {
 		case GUI_VIEW_EXPLORER:
 			ctx.current_dir = dir_get_next(ctx.dirs, ctx.current_dir);
-			render_view_explorer();
+			invalidate(GUI_WIDGET_ALL);
 			break;
 
-		case GUI_VIEW_PLAYBACK: {
-			ctx.current_dir = dir_get_next(ctx.dirs, ctx.current_dir);
-			const FILINFO *fno = (FILINFO *)ctx.current_dir->data;
-			start_playback(fno->fname);
-			render_view_playback(GUI_REFRESH_ALL);
-		} break;
+		case GUI_VIEW_PLAYBACK:
+			play_adjacent(true);
+			break;
+
+		case GUI_VIEW_JUMP:
+			jump_cycle(true);
+			invalidate(GUI_WIDGET_ALL);
+			break;
 
 		default:
 			break;
@@ -217,32 +480,41 @@ static void callback_left(void) {
 	switch (ctx.view) {
 		case GUI_VIEW_EXPLORER:
 			if (dir_return() == 0) {
-				ctx.last_playback_dir = NULL;
-				refresh_list();
-				render_view_explorer();
+				change_dir();
+
+				/* Put cursor back on the directory just left */
+				if (ctx.dir_depth > 0) {
+					ctx.dir_depth--;
+				}
+				if ((ctx.dir_depth < GUI_RETURN_STACK_DEPTH) && (ctx.return_stack[ctx.dir_depth] < dir_list_size(ctx.dirs))) {
+					ctx.current_dir = ctx.return_stack[ctx.dir_depth];
+				}
+				invalidate(GUI_WIDGET_ALL);
 			}
 			break;
 
 		case GUI_VIEW_PLAYBACK:
 			if (player_get_state() == PLAYER_PLAYING) {
-				ctx.volume -= GUI_VOLUME_STEP;
-				ctx.volume = clamp(ctx.volume, GUI_MIN_VOLUME, GUI_MAX_VOLUME);
-				player_set_volume(ctx.volume);
-				render_view_volume();
-				ctx.view = GUI_VIEW_VOLUME;
+				change_volume(-GUI_VOLUME_STEP);
 			}
 			else {
-				ctx.last_playback_dir = ctx.current_dir;
-				ctx.view = GUI_VIEW_EXPLORER;
-				render_view_explorer();
+				switch_view(GUI_VIEW_EXPLORER);
 			}
 			break;
 
 		case GUI_VIEW_VOLUME:
-			ctx.volume -= GUI_VOLUME_STEP;
-			ctx.volume = clamp(ctx.volume, GUI_MIN_VOLUME, GUI_MAX_VOLUME);
-			player_set_volume(ctx.volume);
-			render_view_volume();
+			change_volume(-GUI_VOLUME_STEP);
+			break;
+
+		case GUI_VIEW_JUMP:
+			/* Remove last character, leave without moving the cursor once there's nothing left */
+			ctx.jump_prefix[--ctx.jump_length] = '\0';
+			if (ctx.jump_length == 0) {
+				switch_view(GUI_VIEW_EXPLORER);
+				break;
+			}
+			ctx.jump_entry = dir_find(ctx.dirs, ctx.jump_prefix);
+			invalidate(GUI_WIDGET_ALL);
 			break;
 
 		default:
@@ -252,29 +524,36 @@ static void callback_left(void) {
 
 static void callback_right(void) {
 	switch (ctx.view) {
-		case GUI_VIEW_EXPLORER:
-			if ((player_get_state() == PLAYER_PAUSED) && (ctx.last_playback_dir != NULL)) {
-				ctx.current_dir = ctx.last_playback_dir;
-				render_view_playback(GUI_REFRESH_ALL);
-				ctx.view = GUI_VIEW_PLAYBACK;
+		case GUI_VIEW_EXPLORER: {
+			/* Paused track is kept in the queue regardless of browsing */
+			if ((player_get_state() == PLAYER_PAUSED) && (queue_get_current() != NULL)) {
+				switch_view(GUI_VIEW_PLAYBACK);
+				break;
 			}
-			break;
+
+			/* Play the whole tree beneath highlighted directory, shuffle otherwise */
+			const dir_info_t *info = dir_get_info(ctx.dirs, ctx.current_dir);
+			if ((info != NULL) && is_directory(info)) {
+				show_playback(queue_play_tree(dir_get_fs_path(), info->name));
+			}
+			else {
+				show_playback(start_shuffle());
+			}
+		} break;
 
 		case GUI_VIEW_PLAYBACK:
 			if (player_get_state() == PLAYER_PLAYING) {
-				ctx.volume += GUI_VOLUME_STEP;
-				ctx.volume = clamp(ctx.volume, GUI_MIN_VOLUME, GUI_MAX_VOLUME);
-				player_set_volume(ctx.volume);
-				render_view_volume();
-				ctx.view = GUI_VIEW_VOLUME;
+				change_volume(GUI_VOLUME_STEP);
 			}
 			break;
 
 		case GUI_VIEW_VOLUME:
-			ctx.volume += GUI_VOLUME_STEP;
-			ctx.volume = clamp(ctx.volume, GUI_MIN_VOLUME, GUI_MAX_VOLUME);
-			player_set_volume(ctx.volume);
-			render_view_volume();
+			change_volume(GUI_VOLUME_STEP);
+			break;
+
+		case GUI_VIEW_JUMP:
+			jump_append();
+			invalidate(GUI_WIDGET_ALL);
 			break;
 
 		default:
@@ -282,27 +561,62 @@ static void callback_right(void) {
 	}
 }
 
+/* Holding right in explorer starts jumping to entries by their first letters */
+static void callback_hold_right(void) {
+	if (ctx.view != GUI_VIEW_EXPLORER) {
+		callback_right();
+		return;
+	}
+
+	/* Start from the letter of highlighted entry */
+	const dir_info_t *info = dir_get_info(ctx.dirs, ctx.current_dir);
+	if (info == NULL) {
+		return;
+	}
+
+	ctx.jump_prefix[0] = (jump_char(info->name[0]) != '\0') ? jump_char(info->name[0]) : GUI_JUMP_CHARSET[0];
+	ctx.jump_prefix[1] = '\0';
+	ctx.jump_length = 1;
+
+	/* Listing not sorted, there's no way to search it */
+	ctx.jump_entry = dir_find(ctx.dirs, ctx.jump_prefix);
+	if (ctx.jump_entry == DIR_ENTRY_INVALID) {
+		return;
+	}
+
+	switch_view(GUI_VIEW_JUMP);
+}
+
 static void callback_enter(void) {
 	switch (ctx.view) {
 		case GUI_VIEW_EXPLORER: {
 			/* Empty directory case */
-			if (ctx.current_dir == NULL) {
+			if (ctx.current_dir == DIR_ENTRY_INVALID) {
+				break;
+			}
+
+			const dir_info_t *info = dir_get_info(ctx.dirs, ctx.current_dir);
+			if (info == NULL) {
 				break;
 			}
 
-			const FILINFO *fno = (FILINFO *)ctx.current_dir->data;
-			if (is_directory(fno)) {
+			if (is_directory(info)) {
 				/* Get inside the directory */
-				if (dir_enter(fno->fname) == 0) {
-					ctx.last_playback_dir = NULL;
-					refresh_list();
-					render_view_explorer();
+				if (dir_enter(info->name) == 0) {
+					if (ctx.dir_depth < GUI_RETURN_STACK_DEPTH) {
+						ctx.return_stack[ctx.dir_depth] = ctx.current_dir;
+					}
+					ctx.dir_depth++;
+
+					change_dir();
+					invalidate(GUI_WIDGET_ALL);
 				}
 			}
+			else if (playlist_is_playlist(info->name)) {
+				show_playback(queue_play_playlist(dir_get_fs_path(), info->name));
+			}
 			else {
-				start_playback(fno->fname);
-				render_view_playback(GUI_REFRESH_ALL);
-				ctx.view = GUI_VIEW_PLAYBACK;
+				show_playback(queue_play_dir(dir_get_fs_path(), ctx.current_dir));
 			}
 		} break;
 
@@ -316,46 +630,170 @@ static void callback_enter(void) {
 			}
 		} break;
 
+		case GUI_VIEW_JUMP:
+			/* Search fails if the card can't be read, cursor stays where it was then */
+			if (ctx.jump_entry != DIR_ENTRY_INVALID) {
+				ctx.current_dir = ctx.jump_entry;
+			}
+			switch_view(GUI_VIEW_EXPLORER);
+			break;
+
 		default:
 			break;
 	}
 }
 
+/* Holding enter in playback view switches between elapsed time and progress bar */
+static void callback_hold_enter(void) {
+	if (ctx.view != GUI_VIEW_PLAYBACK) {
+		callback_enter();
+		return;
+	}
+
+	ctx.playback_mode = (ctx.playback_mode + 1) % GUI_PLAYBACK_MODES_NUM;
+	invalidate(GUI_WIDGET_ALL);
+}
+
+/* Start listing highlighted directory ahead of time, once cursor stops on it. Index of the directory,
+ * if it has to be built, is built by gui_prefetch_task in background. */
+static void prefetch_task(uint32_t current_tick) {
+	if ((ctx.current_dir == DIR_ENTRY_INVALID) ||
+		(ctx.current_dir == ctx.prefetched_dir) ||
+		((current_tick - ctx.last_explorer_tick) < GUI_PREFETCH_DELAY) ||
+		player_refill_pending()) {
+		return;
+	}
+
+	/* Attempted only once per entry, even if it fails */
+	ctx.prefetched_dir = ctx.current_dir;
+
+	const dir_info_t *info = dir_get_info(ctx.dirs, ctx.current_dir);
+	if ((info != NULL) && is_directory(info)) {
+		dir_prefetch(info->name);
+	}
+}
+
+/* Invalidates status line of playback view when any of the values it shows changes */
+static void poll_playback(uint32_t current_tick) {
+	const queue_track_t *track = queue_get_current();
+	if (track == NULL) {
+		return;
+	}
+
+	/* Spectrum changes all the time, it's simply redrawn at fixed rate */
+	if (ctx.playback_mode == GUI_PLAYBACK_SPECTRUM) {
+		if ((current_tick - ctx.last_refresh_tick) > GUI_SPECTRUM_REFRESH_INTERVAL) {
+			invalidate(GUI_WIDGET_ALL);
+			ctx.last_refresh_tick = current_tick;
+		}
+		return;
+	}
+
+	/* Bitrate is sampled at fixed rate, total time shows up once it's known */
+	if ((current_tick - ctx.last_refresh_tick) > GUI_PLAYBACK_REFRESH_INTERVAL) {
+		const int32_t total_time = get_total_time(track->size);
+		if (total_time != ctx.total_time) {
+			ctx.total_time = total_time;
+			invalidate(GUI_WIDGET_STATUS);
+		}
+
+		/* Status line used to be redrawn on every interval, count the times it wasn't needed */
+		if (!ctx.status_rendered) {
+			ctx.stats.renders_avoided++;
+		}
+		ctx.status_rendered = false;
+		ctx.last_refresh_tick = current_tick;
+	}
+
+	/* Progress bar moves slower than time for tracks longer than 100 seconds, it's updated along with it */
+	const uint32_t elapsed_time = get_elapsed_time();
+	if (elapsed_time != ctx.elapsed_time) {
+		ctx.elapsed_time = elapsed_time;
+		invalidate(GUI_WIDGET_STATUS);
+	}
+
+	const player_state_t state = player_get_state();
+	if (state != ctx.player_state) {
+		ctx.player_state = state;
+		invalidate(GUI_WIDGET_STATUS);
+	}
+}
+
+static void update_stats(uint32_t current_tick) {
+	if ((current_tick - ctx.last_stats_tick) < GUI_STATS_PERIOD) {
+		return;
+	}
+
+	ctx.stats.renders_avoided_last_minute = ctx.stats.renders_avoided - ctx.stats_period_start;
+	ctx.stats_period_start = ctx.stats.renders_avoided;
+	ctx.last_stats_tick = current_tick;
+}
+
 /* It's VERY BAD that it's here, but I had no better idea... */
 static void refresh_task(void) {
 	const uint32_t current_tick = HAL_GetTick();
 
-	switch (ctx.view) {
-		case GUI_VIEW_PLAYBACK: {
-			/* Refresh playback elapsed time */
-			if ((current_tick - ctx.last_refresh_tick) > GUI_PLAYBACK_REFRESH_INTERVAL) {
-				render_view_playback(GUI_REFRESH_TIME);
-				ctx.last_refresh_tick = current_tick;
-			}
+	/* Player moved on to the track opened ahead by itself, follow it */
+	if (player_next_started() && (queue_next() == 0)) {
+		on_track_started();
+	}
 
+	switch (ctx.view) {
+		case GUI_VIEW_PLAYBACK:
 			/* Check if next song should be played */
-			const dir_entry_t *first_dir = ctx.dirs->head;
-			dir_entry_t *next_dir = dir_get_next(ctx.dirs, ctx.current_dir);
-
-			if ((player_get_state() == PLAYER_STOPPED) && (first_dir != next_dir)) {
-				ctx.current_dir = next_dir;
-
-				const FILINFO *fno = (FILINFO *)ctx.current_dir->data;
-				start_playback(fno->fname);
-				render_view_playback(GUI_REFRESH_ALL);
+			if ((player_get_state() == PLAYER_STOPPED) && (queue_next() == 0)) {
+				start_playback();
 			}
-		} break;
+
+			poll_playback(current_tick);
+			break;
 
 		case GUI_VIEW_VOLUME:
 			if ((current_tick - ctx.last_volume_tick) > GUI_VOLUME_VIEW_DISPLAY_TIME) {
-				render_view_playback(GUI_REFRESH_ALL);
-				ctx.view = GUI_VIEW_PLAYBACK;
+				switch_view(GUI_VIEW_PLAYBACK);
 			}
 			break;
 
+		case GUI_VIEW_EXPLORER:
+			prefetch_task(current_tick);
+			break;
+
+		default:
+			break;
+	}
+
+	update_stats(current_tick);
+}
+
+/* Redraws invalidated widgets of current view. Not while audio waits for refill, it comes first. */
+static void render(void) {
+	if ((ctx.dirty_widgets == 0) || player_refill_pending()) {
+		return;
+	}
+
+	switch (ctx.view) {
+		case GUI_VIEW_EXPLORER:
+			render_view_explorer();
+			break;
+
+		case GUI_VIEW_PLAYBACK:
+			render_view_playback(ctx.dirty_widgets);
+			break;
+
+		case GUI_VIEW_VOLUME:
+			render_view_volume();
+			break;
+
+		case GUI_VIEW_JUMP:
+			render_view_jump();
+			break;
+
 		default:
 			break;
 	}
+
+	ctx.dirty_widgets = 0;
+	ctx.stats.renders++;
 }
 
 void gui_init(void) {
@@ -368,6 +806,8 @@ void gui_init(void) {
 	keyboard_attach_callback(KEYBOARD_LEFT, callback_left);
 	keyboard_attach_callback(KEYBOARD_RIGHT, callback_right);
 	keyboard_attach_callback(KEYBOARD_ENTER, callback_enter);
+	keyboard_attach_hold_callback(KEYBOARD_RIGHT, callback_hold_right);
+	keyboard_attach_hold_callback(KEYBOARD_ENTER, callback_hold_enter);
 
 	/* Get initial directory listing */
 	refresh_list();
@@ -375,17 +815,33 @@ void gui_init(void) {
 	/* Set initial volume */
 	ctx.volume = GUI_DEFAULT_VOLUME;
 
-	/* Set default view and render it */
-	ctx.view = GUI_VIEW_EXPLORER;
-	render_view_explorer();
+	/* Set default view, it's rendered on first task call */
+	switch_view(GUI_VIEW_EXPLORER);
 }
 
 void gui_task(void) {
 	keyboard_task();
-	display_task();
 	refresh_task();
+	render();
+	display_task();
+}
+
+void gui_prefetch_task(void) {
+	/* Yield as soon as the audio buffer needs data or the slice budget is used up */
+	while ((dir_prefetch_step() > 0) && !scheduler_should_yield());
+}
+
+void gui_get_stats(gui_stats_t *stats) {
+	/* Sanity check */
+	if (stats == NULL) {
+		return;
+	}
+
+	*stats = ctx.stats;
 }
 
 void gui_deinit(void) {
+	release_view_glyphs();
+	queue_clear();
 	dir_list_free(ctx.dirs);
 }
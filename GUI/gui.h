@@ -9,6 +9,7 @@
 #define GUI_H_
 
 #include "CS43L22.h"
+#include <stdint.h>
 
 #define GUI_SCROLL_DELAY 250 // ms
 
@@ -17,11 +18,22 @@
 #define GUI_DEFAULT_VOLUME (-39 * CS43L22_VOLUME_STEPS_PER_DB) // -39dB
 #define GUI_VOLUME_STEP (3 * CS43L22_VOLUME_STEPS_PER_DB) // 3dB
 
+typedef struct {
+	uint32_t renders; // Passes redrawing invalidated parts of current view
+	uint32_t renders_avoided; // Playback refresh intervals status line would have been redrawn in with nothing changed
+	uint32_t renders_avoided_last_minute;
+} gui_stats_t;
 
 void gui_init(void);
 
 void gui_task(void);
 
+/* Builds listing of directory the cursor rests on, in slices - to be run in background */
+void gui_prefetch_task(void);
+
+/* Rendering counters, for checking how much work invalidation saves */
+void gui_get_stats(gui_stats_t *stats);
+
 void gui_deinit(void);
 
 #endif /* GUI_H_ */
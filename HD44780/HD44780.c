@@ -8,11 +8,39 @@
 #include "HD44780.h"
 #include <string.h>
 #include <stdlib.h>
+#include <stdbool.h>
 
 /* Needed in HD44780_write_integer() */
 #define HD44780_TMP_BUF_SIZE 11 // Value stored in int32_t has at most 10 digits - 2147483647 - one additional byte for null-terminator
 #define HD44780_CGRAM_CHAR_SIZE 8 // Each custom char uses 8 bytes
 
+#define HD44780_ENABLE_PULSE_TIME 1 // At least 450ns (HD44780 datasheet, p. 49)
+#define HD44780_EXECUTION_TIME 50 // At least 37us for most of the commands (HD44780 datasheet, Table 6, p. 24)
+#define HD44780_CLEAR_EXECUTION_TIME 1600 // At least 1.52ms (HD44780 datasheet, Table 6, p. 24)
+
+#define HD44780_QUEUE_SIZE 128 // Has to be a power of two
+
+typedef struct {
+	uint8_t byte;
+	uint8_t mode;
+	uint16_t execution_time; // How long to wait after the byte is written, us
+} HD44780_queue_entry_t;
+
+typedef enum {
+	HD44780_STEP_UPPER_NIBBLE,
+	HD44780_STEP_LOWER_NIBBLE,
+	HD44780_STEP_LATCH
+} HD44780_step_t;
+
+/* Single producer (HD44780 functions), single consumer (timer callback) ring buffer */
+typedef struct {
+	HD44780_queue_entry_t entries[HD44780_QUEUE_SIZE];
+	size_t head; // Modified by producer only
+	size_t tail; // Modified by consumer only
+	HD44780_step_t step;
+	bool running; // Timer is clocking the queue out, whoever sets it first starts it
+} HD44780_queue_t;
+
 typedef struct {
 	size_t rows;
 	size_t columns;
@@ -31,21 +59,78 @@ static HD44780_type_data_t HD44780_type_data[HD44780_DISPLAY_TYPES_NUM] = {
 };
 
 static HD44780_config_t* HD44780_config = NULL;
+static HD44780_queue_t HD44780_queue;
+
+/* Sets RS line state and data lines */
+static void HD44780_write_nibble(uint8_t nibble, HD44780_mode_t mode) {
+	const HD44780_pin_state_t rs_state = (mode == HD44780_CHARACTER) ? HD44780_HIGH : HD44780_LOW;
+
+	if (HD44780_config->io->write_bus != NULL) {
+		HD44780_config->io->write_bus(nibble, rs_state);
+		return;
+	}
+
+	HD44780_config->io->set_pin_state(HD44780_PIN_RS, rs_state);
+	HD44780_config->io->set_pin_state(HD44780_PIN_D7, (nibble & (1 << 3)) ? HD44780_HIGH : HD44780_LOW);
+	HD44780_config->io->set_pin_state(HD44780_PIN_D6, (nibble & (1 << 2)) ? HD44780_HIGH : HD44780_LOW);
+	HD44780_config->io->set_pin_state(HD44780_PIN_D5, (nibble & (1 << 1)) ? HD44780_HIGH : HD44780_LOW);
+	HD44780_config->io->set_pin_state(HD44780_PIN_D4, (nibble & (1 << 0)) ? HD44780_HIGH : HD44780_LOW);
+}
+
+/* Writes the byte waiting in place for all the timings */
+static void HD44780_write_blocking(uint8_t byte, HD44780_mode_t mode, uint16_t execution_time) {
+	/* Write upper nibble and pulse enable signal */
+	HD44780_write_nibble(byte >> 4, mode);
+	HD44780_config->io->set_pin_state(HD44780_PIN_E, HD44780_HIGH);
+	HD44780_config->io->delay_us(HD44780_ENABLE_PULSE_TIME);
+	HD44780_config->io->set_pin_state(HD44780_PIN_E, HD44780_LOW);
+
+	/* Write lower nibble and pulse enable signal */
+	HD44780_write_nibble(byte & 0x0F, mode);
+	HD44780_config->io->set_pin_state(HD44780_PIN_E, HD44780_HIGH);
+	HD44780_config->io->delay_us(HD44780_ENABLE_PULSE_TIME);
+	HD44780_config->io->set_pin_state(HD44780_PIN_E, HD44780_LOW);
+
+	/* Wait for command to be executed */
+	HD44780_config->io->delay_us(execution_time);
+}
+
+/* Puts the byte into the queue clocked out by timer, or writes it in place if there's no timer */
+static void HD44780_write(uint8_t byte, HD44780_mode_t mode, uint16_t execution_time) {
+	if (HD44780_config->io->start_timer == NULL) {
+		HD44780_write_blocking(byte, mode, execution_time);
+		return;
+	}
+
+	const size_t head = HD44780_queue.head;
+	const size_t next_head = (head + 1) & (HD44780_QUEUE_SIZE - 1);
+
+	/* Queue full, wait for the timer to make some space */
+	while (next_head == __atomic_load_n(&HD44780_queue.tail, __ATOMIC_ACQUIRE));
+
+	HD44780_queue.entries[head].byte = byte;
+	HD44780_queue.entries[head].mode = mode;
+	HD44780_queue.entries[head].execution_time = execution_time;
+	__atomic_store_n(&HD44780_queue.head, next_head, __ATOMIC_RELEASE);
+
+	/* Start clocking out if the timer is idle */
+	if (!__atomic_test_and_set(&HD44780_queue.running, __ATOMIC_ACQ_REL)) {
+		HD44780_config->io->start_timer(HD44780_ENABLE_PULSE_TIME);
+	}
+}
 
 void HD44780_init(HD44780_config_t* const config) {
 	HD44780_config = config;
+	memset(&HD44780_queue, 0, sizeof(HD44780_queue));
 
 	/* If type is invalid, choose the most popular display */
 	if ((HD44780_config->type < 0) || (HD44780_config->type >= HD44780_DISPLAY_TYPES_NUM)) {
 		HD44780_config->type = HD44780_DISPLAY_16x2;
 	}
 
-	HD44780_write_cmd(0x03);
-	HD44780_config->io->delay_us(4500); // Wait for more than 4.1ms (HD44780 datasheet, Fig. 24, p. 46)
-	HD44780_write_cmd(0x03);
-	HD44780_config->io->delay_us(150); // Wait for more than 100us
-	HD44780_write_cmd(0x03);
-	HD44780_config->io->delay_us(100); // Not specified in DS, chosen empirically
+	HD44780_write(0x03, HD44780_INSTRUCTION, 4500); // Wait for more than 4.1ms (HD44780 datasheet, Fig. 24, p. 46)
+	HD44780_write(0x03, HD44780_INSTRUCTION, 150); // Wait for more than 100us
+	HD44780_write(0x03, HD44780_INSTRUCTION, 100); // Not specified in DS, chosen empirically
 	HD44780_write_cmd(0x02);
 
 	/* Here begins the real configuration */
@@ -64,33 +149,7 @@ void HD44780_init(HD44780_config_t* const config) {
 }
 
 void HD44780_write_byte(uint8_t byte, HD44780_mode_t mode) {
-	/* Set RS line state */
-	HD44780_config->io->set_pin_state(HD44780_PIN_RS, (mode == HD44780_CHARACTER) ? HD44780_HIGH : HD44780_LOW);
-
-	/* Write upper nibble */
-	HD44780_config->io->set_pin_state(HD44780_PIN_D7, (byte & (1 << 7)) ? HD44780_HIGH : HD44780_LOW);
-	HD44780_config->io->set_pin_state(HD44780_PIN_D6, (byte & (1 << 6)) ? HD44780_HIGH : HD44780_LOW);
-	HD44780_config->io->set_pin_state(HD44780_PIN_D5, (byte & (1 << 5)) ? HD44780_HIGH : HD44780_LOW);
-	HD44780_config->io->set_pin_state(HD44780_PIN_D4, (byte & (1 << 4)) ? HD44780_HIGH : HD44780_LOW);
-
-	/* Pulse enable signal */
-	HD44780_config->io->set_pin_state(HD44780_PIN_E, HD44780_HIGH);
-	HD44780_config->io->delay_us(1); // At least 450ns (HD44780 datasheet, p. 49)
-	HD44780_config->io->set_pin_state(HD44780_PIN_E, HD44780_LOW);
-
-	/* Write lower nibble */
-	HD44780_config->io->set_pin_state(HD44780_PIN_D7, (byte & (1 << 3)) ? HD44780_HIGH : HD44780_LOW);
-	HD44780_config->io->set_pin_state(HD44780_PIN_D6, (byte & (1 << 2)) ? HD44780_HIGH : HD44780_LOW);
-	HD44780_config->io->set_pin_state(HD44780_PIN_D5, (byte & (1 << 1)) ? HD44780_HIGH : HD44780_LOW);
-	HD44780_config->io->set_pin_state(HD44780_PIN_D4, (byte & (1 << 0)) ? HD44780_HIGH : HD44780_LOW);
-
-	/* Pulse enable signal */
-	HD44780_config->io->set_pin_state(HD44780_PIN_E, HD44780_HIGH);
-	HD44780_config->io->delay_us(1);
-	HD44780_config->io->set_pin_state(HD44780_PIN_E, HD44780_LOW);
-
-	/* Wait at least 37us for command to be executed (HD44780 datasheet, Table 6, p. 24) */
-	HD44780_config->io->delay_us(50);
+	HD44780_write(byte, mode, HD44780_EXECUTION_TIME);
 }
 
 void HD44780_write_cmd(uint8_t command) {
@@ -103,8 +162,7 @@ void HD44780_write_char(char character) {
 
 void HD44780_clear(void) {
 	/* Clear display */
-	HD44780_write_cmd(HD44780_CLEAR_DISPLAY_CMD);
-	HD44780_config->io->delay_us(1600); // At least 1.52ms (HD44780 datasheet, Table 6, p. 24)
+	HD44780_write(HD44780_CLEAR_DISPLAY_CMD, HD44780_INSTRUCTION, HD44780_CLEAR_EXECUTION_TIME);
 
 	/* Set cursor to the first column of the first row */
 	HD44780_type_data_t type_data = HD44780_type_data[HD44780_config->type];
@@ -188,3 +246,43 @@ void HD44780_load_custom_glyphs(const uint8_t* const glyphs_array) {
 		HD44780_load_custom_glyph(&glyphs_array[i * HD44780_CGRAM_CHAR_SIZE], i);
 	}
 }
+
+void HD44780_timer_callback(void) {
+	const HD44780_queue_entry_t *entry = &HD44780_queue.entries[HD44780_queue.tail];
+
+	switch (HD44780_queue.step) {
+		case HD44780_STEP_UPPER_NIBBLE:
+			/* Nothing more to write - go idle, unless something was added in the meantime and nobody restarted the timer */
+			if (HD44780_queue.tail == __atomic_load_n(&HD44780_queue.head, __ATOMIC_ACQUIRE)) {
+				__atomic_clear(&HD44780_queue.running, __ATOMIC_RELEASE);
+				if ((HD44780_queue.tail == __atomic_load_n(&HD44780_queue.head, __ATOMIC_ACQUIRE)) ||
+					__atomic_test_and_set(&HD44780_queue.running, __ATOMIC_ACQ_REL)) {
+					return;
+				}
+			}
+
+			HD44780_write_nibble(entry->byte >> 4, entry->mode);
+			HD44780_config->io->set_pin_state(HD44780_PIN_E, HD44780_HIGH);
+			HD44780_queue.step = HD44780_STEP_LOWER_NIBBLE;
+			HD44780_config->io->start_timer(HD44780_ENABLE_PULSE_TIME);
+			break;
+
+		case HD44780_STEP_LOWER_NIBBLE:
+			HD44780_config->io->set_pin_state(HD44780_PIN_E, HD44780_LOW);
+			HD44780_write_nibble(entry->byte & 0x0F, entry->mode);
+			HD44780_config->io->set_pin_state(HD44780_PIN_E, HD44780_HIGH);
+			HD44780_queue.step = HD44780_STEP_LATCH;
+			HD44780_config->io->start_timer(HD44780_ENABLE_PULSE_TIME);
+			break;
+
+		case HD44780_STEP_LATCH:
+			HD44780_config->io->set_pin_state(HD44780_PIN_E, HD44780_LOW);
+			__atomic_store_n(&HD44780_queue.tail, (HD44780_queue.tail + 1) & (HD44780_QUEUE_SIZE - 1), __ATOMIC_RELEASE);
+			HD44780_queue.step = HD44780_STEP_UPPER_NIBBLE;
+			HD44780_config->io->start_timer(entry->execution_time);
+			break;
+
+		default:
+			break;
+	}
+}
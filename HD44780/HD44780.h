@@ -85,6 +85,11 @@ typedef enum {
 typedef struct {
 	void (*set_pin_state)(HD44780_pin_t pin, HD44780_pin_state_t state);
 	void (*delay_us)(uint16_t us);
+	/* Optional - sets D4-D7 to the nibble and RS to given state at once. If not provided, pins are set one by one. */
+	void (*write_bus)(uint8_t nibble, HD44780_pin_state_t rs_state);
+	/* Optional - starts one-shot timer calling HD44780_timer_callback() after given time. If provided, writes are
+	 * queued and clocked out from the timer callback instead of blocking, otherwise they're done in place. */
+	void (*start_timer)(uint16_t us);
 } HD44780_io_t;
 
 typedef struct {
@@ -169,4 +174,9 @@ void HD44780_load_custom_glyph(const uint8_t* const glyph_array, HD44780_glyph_a
  */
 void HD44780_load_custom_glyphs(const uint8_t* const glyphs_array);
 
+/**
+ * @brief Clocks out the queued writes, has to be called when the timer started with start_timer() expires
+ */
+void HD44780_timer_callback(void);
+
 #endif /* HD44780_H_ */
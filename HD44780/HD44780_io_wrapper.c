@@ -11,6 +11,12 @@
 
 #define HD44780_GPIO_PORT GPIOD
 
+/* Fixed layout for single write bus access - D4-D7 on consecutive pins, RS on its own */
+#define HD44780_DATA_PINS_SHIFT 0 // D4 on PD0
+#define HD44780_DATA_PINS_MASK (GPIO_PIN_0 | GPIO_PIN_1 | GPIO_PIN_2 | GPIO_PIN_3)
+#define HD44780_RS_PIN GPIO_PIN_6
+#define HD44780_BSRR_RESET_SHIFT 16 // Upper half of BSRR resets pins
+
 typedef struct {
 	uint16_t gpio_pin;
 	HD44780_pin_t display_pin;
@@ -25,6 +31,8 @@ static HD44780_gpio_map_t gpio_map[HD44780_PIN_NUM] = {
 		{.gpio_pin = GPIO_PIN_7, .display_pin = HD44780_PIN_E}
 };
 
+static TIM_HandleTypeDef *queue_timer = NULL;
+
 static void set_pin_state(HD44780_pin_t pin, HD44780_pin_state_t state) {
 	for (size_t i = 0; i < HD44780_PIN_NUM; ++i) {
 		if (gpio_map[i].display_pin == pin) {
@@ -34,11 +42,44 @@ static void set_pin_state(HD44780_pin_t pin, HD44780_pin_state_t state) {
 	}
 }
 
+/* Sets data lines and RS with one BSRR write instead of a map search and HAL call per pin */
+static void write_bus(uint8_t nibble, HD44780_pin_state_t rs_state) {
+	const uint32_t set = ((nibble << HD44780_DATA_PINS_SHIFT) & HD44780_DATA_PINS_MASK) | ((rs_state == HD44780_HIGH) ? HD44780_RS_PIN : 0);
+	const uint32_t reset = (HD44780_DATA_PINS_MASK | HD44780_RS_PIN) & ~set;
+
+	HD44780_GPIO_PORT->BSRR = set | (reset << HD44780_BSRR_RESET_SHIFT);
+}
+
+/* Timer runs in one-pulse mode with 1us tick, counter stops by itself on update event */
+static void start_timer(uint16_t us) {
+	__HAL_TIM_SET_AUTORELOAD(queue_timer, us);
+	__HAL_TIM_SET_COUNTER(queue_timer, 0);
+	__HAL_TIM_ENABLE(queue_timer);
+}
+
+void HD44780_io_init(TIM_HandleTypeDef *timer) {
+	queue_timer = timer;
+
+	/* Update flag is set by timer initialization, clear it not to get spurious callback */
+	__HAL_TIM_CLEAR_FLAG(queue_timer, TIM_FLAG_UPDATE);
+	__HAL_TIM_ENABLE_IT(queue_timer, TIM_IT_UPDATE);
+}
+
 HD44780_io_t *HD44780_get_io(void) {
 	static HD44780_io_t io = {
 			.set_pin_state = set_pin_state,
-			.delay_us = delay_us
+			.delay_us = delay_us,
+			.write_bus = write_bus
 	};
 
+	/* Without timer writes are done in place */
+	io.start_timer = (queue_timer != NULL) ? start_timer : NULL;
+
 	return &io;
 }
+
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
+	if (htim == queue_timer) {
+		HD44780_timer_callback();
+	}
+}
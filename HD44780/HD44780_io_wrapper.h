@@ -9,9 +9,13 @@
 #define HD44780_IO_WRAPPER_H_
 
 #include "HD44780.h"
+#include "stm32f4xx_hal.h"
 
 //TODO doxy
 
+/* Timer has to tick every 1us and run in one-pulse mode with update interrupt enabled in NVIC */
+void HD44780_io_init(TIM_HandleTypeDef *timer);
+
 HD44780_io_t *HD44780_get_io(void);
 
 #endif /* HD44780_IO_WRAPPER_H_ */
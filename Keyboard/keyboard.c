@@ -11,23 +11,28 @@
 #include "stm32f4xx_hal.h"
 
 #define KEYBOARD_DEBOUNCE_TIME 200 // ms
+#define KEYBOARD_HOLD_TIME 600 // ms
 
 typedef struct {
+	GPIO_TypeDef *gpio_port;
 	uint16_t gpio_pin;
+	GPIO_PinState active_state; // Level when button is pressed
 	keyboard_buttons_t button;
 } keyboard_gpio_map_t;
 
 typedef struct {
 	void (*button_callbacks[KEYBOARD_BUTTONS_NUM])(void);
+	void (*hold_callbacks[KEYBOARD_BUTTONS_NUM])(void);
 	bool button_flags[KEYBOARD_BUTTONS_NUM];
+	uint32_t press_ticks[KEYBOARD_BUTTONS_NUM];
 } keyboard_ctx_t;
 
 static keyboard_gpio_map_t gpio_map[KEYBOARD_BUTTONS_NUM] = {
-		{.gpio_pin = GPIO_PIN_0, .button = KEYBOARD_ENTER},
-		{.gpio_pin = GPIO_PIN_1, .button = KEYBOARD_UP},
-		{.gpio_pin = GPIO_PIN_5, .button = KEYBOARD_DOWN},
-		{.gpio_pin = GPIO_PIN_7, .button = KEYBOARD_LEFT},
-		{.gpio_pin = GPIO_PIN_8, .button = KEYBOARD_RIGHT}
+		{.gpio_port = GPIOA, .gpio_pin = GPIO_PIN_0, .active_state = GPIO_PIN_SET, .button = KEYBOARD_ENTER},
+		{.gpio_port = GPIOA, .gpio_pin = GPIO_PIN_1, .active_state = GPIO_PIN_RESET, .button = KEYBOARD_UP},
+		{.gpio_port = GPIOA, .gpio_pin = GPIO_PIN_5, .active_state = GPIO_PIN_RESET, .button = KEYBOARD_DOWN},
+		{.gpio_port = GPIOA, .gpio_pin = GPIO_PIN_7, .active_state = GPIO_PIN_RESET, .button = KEYBOARD_LEFT},
+		{.gpio_port = GPIOE, .gpio_pin = GPIO_PIN_8, .active_state = GPIO_PIN_RESET, .button = KEYBOARD_RIGHT}
 };
 
 static keyboard_ctx_t ctx;
@@ -44,12 +49,45 @@ void keyboard_attach_callback(keyboard_buttons_t button, void (*callback)(void))
 	ctx.button_callbacks[button] = callback;
 }
 
+void keyboard_attach_hold_callback(keyboard_buttons_t button, void (*callback)(void)) {
+	if ((button < 0) || (button >= KEYBOARD_BUTTONS_NUM)) {
+		return;
+	}
+
+	ctx.hold_callbacks[button] = callback;
+}
+
+static bool is_pressed(keyboard_buttons_t button) {
+	for (size_t i = 0; i < KEYBOARD_BUTTONS_NUM; ++i) {
+		if (gpio_map[i].button == button) {
+			return (HAL_GPIO_ReadPin(gpio_map[i].gpio_port, gpio_map[i].gpio_pin) == gpio_map[i].active_state);
+		}
+	}
+	return false;
+}
+
 void keyboard_task(void) {
 	for (size_t i = 0; i < KEYBOARD_BUTTONS_NUM; ++i) {
-		if (ctx.button_flags[i] && (ctx.button_callbacks[i] != NULL)) {
+		if (!ctx.button_flags[i]) {
+			continue;
+		}
+
+		/* Button with hold action - press is known only after release, hold after the button is kept long enough */
+		if (ctx.hold_callbacks[i] != NULL) {
+			if (is_pressed(i)) {
+				if ((HAL_GetTick() - ctx.press_ticks[i]) < KEYBOARD_HOLD_TIME) {
+					continue;
+				}
+				ctx.button_flags[i] = false;
+				ctx.hold_callbacks[i]();
+				continue;
+			}
+		}
+
+		if (ctx.button_callbacks[i] != NULL) {
 			ctx.button_callbacks[i]();
-			ctx.button_flags[i] = false;
 		}
+		ctx.button_flags[i] = false;
 	}
 }
 
@@ -64,6 +102,7 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
 	for (size_t i = 0; i < KEYBOARD_BUTTONS_NUM; ++i) {
 		if (GPIO_Pin == gpio_map[i].gpio_pin) {
 			ctx.button_flags[gpio_map[i].button] = true;
+			ctx.press_ticks[gpio_map[i].button] = current_tick;
 			break;
 		}
 	}
@@ -21,6 +21,9 @@ void keyboard_init(void);
 
 void keyboard_attach_callback(keyboard_buttons_t button, void (*callback)(void));
 
+/* Called instead of the regular callback when the button is held. Regular one is then called on release. */
+void keyboard_attach_hold_callback(keyboard_buttons_t button, void (*callback)(void));
+
 void keyboard_task(void);
 
 #endif /* KEYBOARD_H_ */
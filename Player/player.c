@@ -9,10 +9,10 @@
 #include "dr_mp3.h"
 #include "player.h"
 #include "CS43L22.h"
+#include "stream.h"
+#include "filename.h"
 #include <errno.h>
 
-#define PLAYER_BUFFER_SIZE_FRAMES (PLAYER_BUFFER_SIZE_SAMPLES / PLAYER_CHANNELS_NUM)
-
 typedef enum {
 	BUFFER_REQ_NONE,
 	BUFFER_REQ_FIRST_HALF,
@@ -22,6 +22,10 @@ typedef enum {
 typedef struct {
 	int16_t dma_buffer[PLAYER_BUFFER_SIZE_SAMPLES];
 	drmp3 mp3;
+	stream_t stream;
+	FIL next_file; // Opened ahead, played right after the current one without stopping the output
+	bool next_prepared;
+	bool next_started; // Set when playback moved on to the prepared file
 	volatile player_buffer_req_t buffer_req;
 	player_state_t state;
 	I2S_HandleTypeDef *i2s;
@@ -30,9 +34,19 @@ typedef struct {
 
 static player_ctx_t ctx;
 
-static bool is_extension(const char *filename, const char *ext) {
-    const char *dot_ptr = strrchr(filename, '.');
-    return ((dot_ptr != NULL) && (strcasecmp(dot_ptr, ext) == 0));
+static size_t mp3_read(void *user_data, void *buffer, size_t bytes_to_read) {
+	return stream_read((stream_t *)user_data, buffer, bytes_to_read);
+}
+
+static drmp3_bool32 mp3_seek(void *user_data, int offset, drmp3_seek_origin origin) {
+	stream_t *stream = (stream_t *)user_data;
+	FSIZE_t position = offset;
+
+	if (origin == drmp3_seek_origin_current) {
+		position += stream_tell(stream);
+	}
+
+	return (stream_seek(stream, position) == 0) ? DRMP3_TRUE : DRMP3_FALSE;
 }
 
 static bool configure_i2s(uint32_t sample_rate) {
@@ -53,6 +67,66 @@ static bool configure_i2s(uint32_t sample_rate) {
 	return (HAL_I2S_Init(ctx.i2s) == HAL_OK);
 }
 
+static void stop_output(void) {
+	CS43L22_deinit(ctx.i2c);
+	HAL_I2S_DMAStop(ctx.i2s);
+
+	ctx.buffer_req = BUFFER_REQ_NONE;
+	ctx.state = PLAYER_STOPPED;
+}
+
+static void close_next(void) {
+	if (ctx.next_prepared) {
+		f_close(&ctx.next_file);
+		ctx.next_prepared = false;
+	}
+}
+
+/* Replaces decoder input with the prepared file, output keeps running if sample rate is the same */
+static bool switch_to_next(void) {
+	const uint32_t sample_rate = player_get_pcm_sample_rate();
+
+	drmp3_uninit(&ctx.mp3);
+	stream_close(&ctx.stream);
+
+	ctx.next_prepared = false;
+	if (stream_attach(&ctx.stream, &ctx.next_file) != 0) {
+		f_close(&ctx.next_file);
+		return false;
+	}
+
+	if (drmp3_init(&ctx.mp3, mp3_read, mp3_seek, &ctx.stream, NULL) != DRMP3_TRUE) {
+		stream_close(&ctx.stream);
+		return false;
+	}
+
+	/* I2S would have to be reconfigured, leave it to a regular start */
+	if (player_get_pcm_sample_rate() != sample_rate) {
+		drmp3_uninit(&ctx.mp3);
+		stream_close(&ctx.stream);
+		return false;
+	}
+
+	ctx.next_started = true;
+	return true;
+}
+
+/* Decodes frames to given half of the buffer, continuing with prepared file if the current one ends */
+static drmp3_uint64 fill_half(int16_t *buffer) {
+	const drmp3_uint64 frames_to_read = PLAYER_BUFFER_SIZE_FRAMES / 2;
+
+	drmp3_uint64 frames_read = drmp3_read_pcm_frames_s16(&ctx.mp3, frames_to_read, buffer);
+	if ((frames_read < frames_to_read) && ctx.next_prepared) {
+		if (!switch_to_next()) {
+			stop_output(); // Decoder is already closed
+			return 0;
+		}
+		frames_read += drmp3_read_pcm_frames_s16(&ctx.mp3, frames_to_read - frames_read, &buffer[frames_read * PLAYER_CHANNELS_NUM]);
+	}
+
+	return frames_read;
+}
+
 void player_init(I2S_HandleTypeDef *i2s, I2C_HandleTypeDef *i2c) {
 	ctx.buffer_req = BUFFER_REQ_NONE;
 	ctx.state = PLAYER_STOPPED;
@@ -70,15 +144,23 @@ int player_start(const char *path) {
 	if (ctx.state != PLAYER_STOPPED) {
 		player_stop();
 	}
+	close_next();
+	ctx.next_started = false;
 
 	/* Check if supported extension */
-	if (!is_extension(path, ".mp3")) {
+	if (!filename_has_extension(path, ".mp3")) {
 		return -ENOTSUP;
 	}
 
+	/* Open file through aligned reader, so that decoder input is fetched with multi-sector reads */
+	if (stream_open(&ctx.stream, path) != 0) {
+		return -EIO;
+	}
+
 	/* Initialize decoder */
-	const drmp3_bool32 drmp3_ret = drmp3_init_file(&ctx.mp3, path, NULL);
+	const drmp3_bool32 drmp3_ret = drmp3_init(&ctx.mp3, mp3_read, mp3_seek, &ctx.stream, NULL);
 	if (drmp3_ret != DRMP3_TRUE) {
+		stream_close(&ctx.stream);
 		return -EIO;
 	}
 
@@ -87,6 +169,7 @@ int player_start(const char *path) {
 	const bool i2s_ret = configure_i2s(pcm_sample_rate);
 	if (!i2s_ret) {
 		drmp3_uninit(&ctx.mp3);
+		stream_close(&ctx.stream);
 		return -EINVAL;
 	}
 
@@ -94,6 +177,7 @@ int player_start(const char *path) {
 	const drmp3_uint64 frames_read = drmp3_read_pcm_frames_s16(&ctx.mp3, PLAYER_BUFFER_SIZE_FRAMES, ctx.dma_buffer);
 	if (frames_read == 0) {
 		drmp3_uninit(&ctx.mp3);
+		stream_close(&ctx.stream);
 		return -EIO;
 	}
 
@@ -101,6 +185,7 @@ int player_start(const char *path) {
 	const HAL_StatusTypeDef dma_ret = HAL_I2S_Transmit_DMA(ctx.i2s, (uint16_t *)ctx.dma_buffer, PLAYER_BUFFER_SIZE_SAMPLES);
 	if (dma_ret != HAL_OK) {
 		drmp3_uninit(&ctx.mp3);
+		stream_close(&ctx.stream);
 		return -EBUSY;
 	}
 
@@ -108,6 +193,7 @@ int player_start(const char *path) {
 	const bool dac_ret = CS43L22_init(ctx.i2c);
 	if (!dac_ret) {
 		drmp3_uninit(&ctx.mp3);
+		stream_close(&ctx.stream);
 		return -EBUSY;
 	}
 
@@ -138,16 +224,41 @@ void player_resume(void) {
 }
 
 void player_stop(void) {
+	close_next();
+
 	if (ctx.state == PLAYER_STOPPED) {
 		return;
 	}
 
-	CS43L22_deinit(ctx.i2c);
-	HAL_I2S_DMAStop(ctx.i2s);
+	stop_output();
 	drmp3_uninit(&ctx.mp3);
+	stream_close(&ctx.stream);
+}
 
-	ctx.buffer_req = BUFFER_REQ_NONE;
-	ctx.state = PLAYER_STOPPED;
+int player_prepare_next(const char *path) {
+	close_next();
+
+	/* Sanity check */
+	if (path == NULL) {
+		return -EINVAL;
+	}
+
+	if (!filename_has_extension(path, ".mp3")) {
+		return -ENOTSUP;
+	}
+
+	if (f_open(&ctx.next_file, path, FA_READ) != FR_OK) {
+		return -EIO;
+	}
+
+	ctx.next_prepared = true;
+	return 0;
+}
+
+bool player_next_started(void) {
+	const bool started = ctx.next_started;
+	ctx.next_started = false;
+	return started;
 }
 
 bool player_set_volume(int8_t volume) {
@@ -170,6 +281,27 @@ uint32_t player_get_mp3_frame_bitrate(void) {
 	return ctx.mp3.mp3FrameBitrate;
 }
 
+bool player_refill_pending(void) {
+	return (ctx.state == PLAYER_PLAYING) && (ctx.buffer_req != BUFFER_REQ_NONE);
+}
+
+const int16_t *player_get_output(size_t *position) {
+	/* Sanity check */
+	if (position == NULL) {
+		return NULL;
+	}
+
+	if ((ctx.state != PLAYER_PLAYING) || (ctx.buffer_req != BUFFER_REQ_NONE)) {
+		return NULL;
+	}
+
+	/* DMA counts down samples remaining to the end of the buffer */
+	const size_t samples_sent = PLAYER_BUFFER_SIZE_SAMPLES - __HAL_DMA_GET_COUNTER(ctx.i2s->hdmatx);
+	*position = (samples_sent / PLAYER_CHANNELS_NUM) % PLAYER_BUFFER_SIZE_FRAMES;
+
+	return ctx.dma_buffer;
+}
+
 void player_task(void) {
 	if ((ctx.state != PLAYER_PLAYING) || (ctx.buffer_req == BUFFER_REQ_NONE)) {
 		return;
@@ -179,12 +311,12 @@ void player_task(void) {
 
 	switch (ctx.buffer_req) {
 		case BUFFER_REQ_FIRST_HALF:
-			frames_read = drmp3_read_pcm_frames_s16(&ctx.mp3, PLAYER_BUFFER_SIZE_FRAMES / 2, ctx.dma_buffer);
+			frames_read = fill_half(ctx.dma_buffer);
 			ctx.buffer_req = BUFFER_REQ_NONE;
 			break;
 
 		case BUFFER_REQ_SECOND_HALF:
-			frames_read = drmp3_read_pcm_frames_s16(&ctx.mp3, PLAYER_BUFFER_SIZE_FRAMES / 2, &ctx.dma_buffer[PLAYER_BUFFER_SIZE_SAMPLES / 2]);
+			frames_read = fill_half(&ctx.dma_buffer[PLAYER_BUFFER_SIZE_SAMPLES / 2]);
 			ctx.buffer_req = BUFFER_REQ_NONE;
 			break;
 
@@ -192,7 +324,8 @@ void player_task(void) {
 			break;
 	}
 
-	if (frames_read == 0) {
+	/* Could have been stopped already by failed switch to the next file */
+	if ((frames_read == 0) && (ctx.state != PLAYER_STOPPED)) {
 		player_stop();
 	}
 }
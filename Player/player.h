@@ -13,6 +13,7 @@
 
 #define PLAYER_BUFFER_SIZE_SAMPLES 16384
 #define PLAYER_CHANNELS_NUM 2
+#define PLAYER_BUFFER_SIZE_FRAMES (PLAYER_BUFFER_SIZE_SAMPLES / PLAYER_CHANNELS_NUM)
 
 typedef enum {
 	PLAYER_STOPPED,
@@ -27,6 +28,13 @@ void player_pause(void);
 void player_resume(void);
 void player_stop(void);
 
+/* Opens file to be played right after the current one ends, without a gap if it has the same sample rate.
+ * Dropped on every start or stop. */
+int player_prepare_next(const char *path);
+
+/* Returns true once after playback moved on to the prepared file */
+bool player_next_started(void);
+
 bool player_set_volume(int8_t volume);
 
 player_state_t player_get_state(void);
@@ -34,6 +42,14 @@ uint64_t player_get_frames_played(void);
 uint32_t player_get_pcm_sample_rate(void);
 uint32_t player_get_mp3_frame_bitrate(void);
 
+/* Returns true if audio buffer is waiting to be refilled, background work should yield then */
+bool player_refill_pending(void);
+
+/* Gives read access to output ring buffer of PLAYER_BUFFER_SIZE_FRAMES frames, e.g. for visualization.
+ * Position is set to the frame being sent to DAC, frames from there on are the ones to be heard next.
+ * Returns NULL if nothing is played or buffer is waiting to be refilled, so it holds stale data. */
+const int16_t *player_get_output(size_t *position);
+
 void player_task(void);
 
 #endif /* PLAYER_H_ */
@@ -0,0 +1,107 @@
+/*
+ * hd44780_bench.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "HD44780.h"
+#include "HD44780_io_wrapper.h"
+#include "stm32f4xx_hal.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+#define HD44780_BENCH_CHARS 200000
+#define HD44780_BENCH_RUNS 10 // Best one is taken, the rest were disturbed by the host
+#define HD44780_BENCH_QUEUE_STEPS 4 // Timer callbacks per character - upper nibble, lower nibble, latch, going idle
+
+GPIO_TypeDef bench_gpiod;
+static TIM_TypeDef bench_timer_regs;
+static TIM_HandleTypeDef bench_timer = {.Instance = &bench_timer_regs};
+
+/* Body of the HAL function, minus parameter asserts compiled out in release */
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+	if (PinState != GPIO_PIN_RESET) {
+		GPIOx->BSRR = GPIO_Pin;
+	}
+	else {
+		GPIOx->BSRR = (uint32_t)GPIO_Pin << 16U;
+	}
+}
+
+/* Newlib extension used by HD44780_write_integer(), not available in glibc */
+char *itoa(int value, char *buffer, int base) {
+	(void)base;
+	sprintf(buffer, "%d", value);
+	return buffer;
+}
+
+/* Waits are left out, only the work of the CPU is measured */
+void delay_us(uint16_t microseconds) {
+	(void)microseconds;
+}
+
+static uint64_t get_time_ns(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/* Returns ns per character, queued ones are clocked out by calling timer callback as the interrupt would */
+static double run(bool queued) {
+	uint64_t best = UINT64_MAX;
+
+	for (size_t run = 0; run < HD44780_BENCH_RUNS; ++run) {
+		const uint64_t start = get_time_ns();
+
+		for (size_t i = 0; i < HD44780_BENCH_CHARS; ++i) {
+			HD44780_write_char('A' + (i % 26));
+			if (queued) {
+				for (size_t step = 0; step < HD44780_BENCH_QUEUE_STEPS; ++step) {
+					HD44780_timer_callback();
+				}
+			}
+		}
+
+		const uint64_t time = get_time_ns() - start;
+		if (time < best) {
+			best = time;
+		}
+	}
+
+	return (double)best / HD44780_BENCH_CHARS;
+}
+
+int main(void) {
+	static HD44780_config_t config = {
+		.type = HD44780_DISPLAY_20x2,
+		.entry_mode_flags = HD44780_INCREASE_CURSOR_ON,
+		.on_off_flags = HD44780_DISPLAY_ON
+	};
+	static const char *const modes[] = {"blocking", "queued"};
+
+	/* Initialized blocking, timer is attached afterwards, the wrapper's io struct follows it */
+	HD44780_io_t *io = HD44780_get_io();
+	void (*const write_bus)(uint8_t, HD44780_pin_state_t) = io->write_bus;
+	config.io = io;
+	HD44780_init(&config);
+
+	printf("CPU time per HD44780_write_char(), waits excluded\n");
+	printf("%-10s %14s %14s %8s\n", "Mode", "Pins [ns]", "Bus [ns]", "Ratio");
+	for (size_t mode = 0; mode < (sizeof(modes) / sizeof(modes[0])); ++mode) {
+		if (mode == 1) {
+			HD44780_io_init(&bench_timer);
+			HD44780_get_io();
+		}
+
+		io->write_bus = NULL;
+		const double pins = run(mode == 1);
+		io->write_bus = write_bus;
+		const double bus = run(mode == 1);
+
+		printf("%-10s %14.2f %14.2f %8.2f\n", modes[mode], pins, bus, pins / bus);
+	}
+
+	return 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * list_sort_bench.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "list.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define LIST_BENCH_MIN_SORTED 20000 // Elements sorted in total for each case, so that small lists are timed too
+
+typedef enum {
+	LIST_BENCH_RANDOM,
+	LIST_BENCH_SORTED,
+	LIST_BENCH_REVERSE
+} list_bench_order_t;
+
+typedef struct {
+	uint32_t key; // Every key occurs twice, so that stability is checked in each order
+	uint32_t sequence; // Position before sorting
+} list_bench_item_t;
+
+typedef struct {
+	void (*sort)(struct list_t *, bool (*)(const void *, const void *));
+	uint64_t compares;
+} list_bench_ctx_t;
+
+static list_bench_ctx_t ctx;
+
+static const size_t sizes[] = {10, 1000, 10000};
+static const char *const order_names[] = {"random", "sorted", "reverse"};
+
+static uint64_t get_time_ns(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static bool compare_items(const void *first, const void *second) {
+	ctx.compares++;
+	return ((const list_bench_item_t *)first)->key > ((const list_bench_item_t *)second)->key;
+}
+
+/* Previous implementation, swapping data of neighbouring nodes */
+static void bubble_sort(struct list_t *list, bool (*compare)(const void *, const void *)) {
+	bool sorted;
+	struct list_node_t *last = NULL;
+
+	do {
+		sorted = true;
+		struct list_node_t *current = list->head;
+
+		while (current->next != last) {
+			if (compare(current->data, current->next->data)) {
+				void *temp = current->data;
+				current->data = current->next->data;
+				current->next->data = temp;
+				sorted = false;
+			}
+			current = current->next;
+		}
+		last = current;
+	} while (!sorted);
+}
+
+static struct list_t *make_list(size_t size, list_bench_order_t order, uint32_t *seed) {
+	struct list_t *list = list_create();
+
+	for (size_t i = 0; i < size; ++i) {
+		list_bench_item_t item = {.sequence = i};
+
+		switch (order) {
+			case LIST_BENCH_RANDOM:
+				*seed = *seed * 1664525 + 1013904223;
+				item.key = (*seed >> 8) % (size / 2);
+				break;
+			case LIST_BENCH_SORTED:
+				item.key = i / 2;
+				break;
+			case LIST_BENCH_REVERSE:
+				item.key = (size - 1 - i) / 2;
+				break;
+		}
+		list_add(list, &item, sizeof(item), LIST_APPEND);
+	}
+	return list;
+}
+
+/* Checks order of keys, order of equal keys, number of elements and backward links */
+static int check_list(const struct list_t *list, size_t size) {
+	const struct list_node_t *prev = NULL;
+	size_t count = 0;
+
+	for (const struct list_node_t *node = list->head; node != NULL; node = node->next) {
+		if (node->prev != prev) {
+			return -1;
+		}
+
+		if (prev != NULL) {
+			const list_bench_item_t *a = prev->data;
+			const list_bench_item_t *b = node->data;
+			if ((a->key > b->key) || ((a->key == b->key) && (a->sequence > b->sequence))) {
+				return -1;
+			}
+		}
+		prev = node;
+		count++;
+	}
+	return ((count == size) && (list->tail == prev)) ? 0 : -1;
+}
+
+static int run_case(const char *name, size_t size, list_bench_order_t order) {
+	const size_t repeats = (LIST_BENCH_MIN_SORTED + size - 1) / size;
+	uint32_t seed = 1;
+	uint64_t time = 0;
+	int ret = 0;
+
+	ctx.compares = 0;
+	for (size_t i = 0; i < repeats; ++i) {
+		struct list_t *list = make_list(size, order, &seed);
+
+		const uint64_t start = get_time_ns();
+		ctx.sort(list, compare_items);
+		time += get_time_ns() - start;
+
+		if (check_list(list, size) != 0) {
+			ret = -1;
+		}
+		list_destroy(list);
+	}
+
+	printf("%-8s %6zu %-8s %12.1f %14.1f%s\n", name, size, order_names[order], (double)time / repeats / 1000.0,
+		   (double)ctx.compares / repeats, (ret == 0) ? "" : " FAIL");
+	return ret;
+}
+
+int main(void) {
+	int failures = 0;
+
+	printf("%-8s %6s %-8s %12s %14s\n", "Sort", "Size", "Order", "Time [us]", "Compares");
+	for (size_t i = 0; i < (sizeof(sizes) / sizeof(sizes[0])); ++i) {
+		for (list_bench_order_t order = LIST_BENCH_RANDOM; order <= LIST_BENCH_REVERSE; ++order) {
+			ctx.sort = list_sort;
+			if (run_case("merge", sizes[i], order) != 0) {
+				failures++;
+			}
+
+			ctx.sort = bubble_sort;
+			if (run_case("bubble", sizes[i], order) != 0) {
+				failures++;
+			}
+		}
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+/*
+ * spectrum_bench.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "spectrum.h"
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+/* Values of the firmware, keep in sync */
+#define SPECTRUM_BENCH_BUFFER_FRAMES 8192 // PLAYER_BUFFER_SIZE_FRAMES
+#define SPECTRUM_BENCH_REFRESH_INTERVAL 40000 // us, GUI_SPECTRUM_REFRESH_INTERVAL
+#define SPECTRUM_BENCH_GUI_BUDGET 10000 // us, budget of GUI task
+#define SPECTRUM_BENCH_REFILL_DEADLINE 30000 // us, deadline of audio task
+
+#define SPECTRUM_BENCH_SAMPLE_RATE 44100
+#define SPECTRUM_BENCH_UPDATES 20000
+#define SPECTRUM_BENCH_STEP (SPECTRUM_BENCH_SAMPLE_RATE * (SPECTRUM_BENCH_REFRESH_INTERVAL / 1000) / 1000) // Frames played between updates
+
+static int16_t frames[2 * SPECTRUM_BENCH_BUFFER_FRAMES];
+
+static uint64_t get_time_ns(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/* Few tones on top of noise, so that every band has something in it */
+static void make_signal(void) {
+	static const double tones[] = {110.0, 1000.0, 6000.0};
+	uint32_t noise = 1;
+
+	for (size_t n = 0; n < SPECTRUM_BENCH_BUFFER_FRAMES; ++n) {
+		double value = 0.0;
+		for (size_t i = 0; i < (sizeof(tones) / sizeof(tones[0])); ++i) {
+			value += 8000.0 * sin(2.0 * M_PI * tones[i] * n / SPECTRUM_BENCH_SAMPLE_RATE);
+		}
+
+		noise = noise * 1664525 + 1013904223;
+		value += (int16_t)(noise >> 16) / 8;
+
+		frames[2 * n] = value;
+		frames[2 * n + 1] = value / 2;
+	}
+}
+
+int main(void) {
+	uint8_t levels[SPECTRUM_BANDS] = {0};
+	uint64_t total = 0;
+	uint64_t best = UINT64_MAX;
+	uint32_t checksum = 0;
+	size_t position = 0;
+
+	make_signal();
+
+	for (size_t i = 0; i < SPECTRUM_BENCH_UPDATES; ++i) {
+		const uint64_t start = get_time_ns();
+		spectrum_update(levels, frames, SPECTRUM_BENCH_BUFFER_FRAMES, position);
+		const uint64_t time = get_time_ns() - start;
+
+		total += time;
+		if (time < best) {
+			best = time;
+		}
+
+		/* Keeps the result in use */
+		for (size_t band = 0; band < SPECTRUM_BANDS; ++band) {
+			checksum += levels[band];
+		}
+		position = (position + SPECTRUM_BENCH_STEP) % SPECTRUM_BENCH_BUFFER_FRAMES;
+	}
+
+	const double mean_us = (double)total / SPECTRUM_BENCH_UPDATES / 1000.0;
+	/* Worst case would be dominated by the host preempting the bench, best one is the cost of the work itself */
+	const double best_us = (double)best / 1000.0;
+
+	printf("Work per update: %d frames in, %d-point FFT, %d bands\n",
+		   SPECTRUM_INPUT_FRAMES, SPECTRUM_FFT_SIZE, SPECTRUM_BANDS);
+	printf("%-24s %10s %10s\n", "", "best", "mean");
+	printf("%-24s %10.2f %10.2f\n", "Time per update [us]", best_us, mean_us);
+	printf("%-24s %10.3f %10.3f\n", "Refresh interval [%]", 100.0 * best_us / SPECTRUM_BENCH_REFRESH_INTERVAL,
+		   100.0 * mean_us / SPECTRUM_BENCH_REFRESH_INTERVAL);
+	printf("%-24s %10.3f %10.3f\n", "GUI budget [%]", 100.0 * best_us / SPECTRUM_BENCH_GUI_BUDGET,
+		   100.0 * mean_us / SPECTRUM_BENCH_GUI_BUDGET);
+	printf("%-24s %10.3f %10.3f\n", "Refill deadline [%]", 100.0 * best_us / SPECTRUM_BENCH_REFILL_DEADLINE,
+		   100.0 * mean_us / SPECTRUM_BENCH_REFILL_DEADLINE);
+	printf("Checksum: %lu\n", (unsigned long)checksum);
+
+	return 0;
+}
@@ -0,0 +1,195 @@
+/*
+ * stream_bench.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#define DR_MP3_IMPLEMENTATION
+#include "dr_mp3.h"
+#include "image_diskio.h"
+#include "stream.h"
+#include "diskio.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define STREAM_BENCH_IMAGE_SIZE (256UL * 1024 * 1024) // Smallest FAT16 with 32 KiB clusters is 128 MiB
+#define STREAM_BENCH_FILE "/track.mp3"
+#define STREAM_BENCH_FRAMES 2000 // About 52 s at 44.1 kHz
+#define STREAM_BENCH_FRAME_SIZE 417 // MPEG-1 Layer III, 128 kbps, 44.1 kHz, no padding
+#define STREAM_BENCH_FRAME_SAMPLES 1152
+#define STREAM_BENCH_DECODE_FRAMES 4096 // Half of the player buffer, decoded per refill
+
+/* Same counters as the SD driver - every disk_read is one CMD17 (single sector) or CMD18 */
+typedef struct {
+	uint32_t read_commands;
+	uint32_t read_sectors;
+	uint32_t single_reads;
+} stream_bench_stats_t;
+
+static stream_bench_stats_t stats;
+
+DRESULT __real_disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count);
+
+DRESULT __wrap_disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count) {
+	stats.read_commands++;
+	stats.read_sectors += count;
+	if (count == 1) {
+		stats.single_reads++;
+	}
+	return __real_disk_read(pdrv, buff, sector, count);
+}
+
+/* Previous path - decoder requests passed to f_read as they come. Newlib stdio in between would
+ * only split them further, into its 1 KiB buffer refills, so this is the best case of it. */
+static size_t file_read(void *user_data, void *buffer, size_t bytes_to_read) {
+	UINT bytes_read;
+	return (f_read((FIL *)user_data, buffer, bytes_to_read, &bytes_read) == FR_OK) ? bytes_read : 0;
+}
+
+static drmp3_bool32 file_seek(void *user_data, int offset, drmp3_seek_origin origin) {
+	FIL *file = (FIL *)user_data;
+	const FSIZE_t position = (origin == drmp3_seek_origin_current) ? (f_tell(file) + offset) : (FSIZE_t)offset;
+	return (f_lseek(file, position) == FR_OK) ? DRMP3_TRUE : DRMP3_FALSE;
+}
+
+/* Player's callbacks */
+static size_t stream_read_callback(void *user_data, void *buffer, size_t bytes_to_read) {
+	return stream_read((stream_t *)user_data, buffer, bytes_to_read);
+}
+
+static drmp3_bool32 stream_seek_callback(void *user_data, int offset, drmp3_seek_origin origin) {
+	stream_t *stream = (stream_t *)user_data;
+	FSIZE_t position = offset;
+
+	if (origin == drmp3_seek_origin_current) {
+		position += stream_tell(stream);
+	}
+	return (stream_seek(stream, position) == 0) ? DRMP3_TRUE : DRMP3_FALSE;
+}
+
+/* Silent frames - decoded like any other, the decoder's read pattern doesn't depend on the content */
+static int write_track(void) {
+	uint8_t frame[STREAM_BENCH_FRAME_SIZE] = {0xFF, 0xFB, 0x90, 0x00};
+	FIL file;
+	UINT bytes_written;
+
+	if (f_open(&file, STREAM_BENCH_FILE, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < STREAM_BENCH_FRAMES; ++i) {
+		if ((f_write(&file, frame, sizeof(frame), &bytes_written) != FR_OK) || (bytes_written != sizeof(frame))) {
+			f_close(&file);
+			return -1;
+		}
+	}
+	return (f_close(&file) == FR_OK) ? 0 : -1;
+}
+
+static int make_image(const char *path, DWORD cluster_size) {
+	static BYTE work[4096];
+	FATFS fatfs;
+
+	FILE *image = fopen(path, "wb");
+	if ((image == NULL) || (ftruncate(fileno(image), STREAM_BENCH_IMAGE_SIZE) != 0)) {
+		return -1;
+	}
+	fclose(image);
+
+	if ((image_diskio_open(path) != 0) || (f_mkfs("", FM_FAT, cluster_size, work, sizeof(work)) != FR_OK) ||
+		(f_mount(&fatfs, "", 1) != FR_OK)) {
+		image_diskio_close();
+		return -1;
+	}
+
+	const int ret = write_track();
+	f_mount(NULL, "", 0);
+	image_diskio_close();
+	return ret;
+}
+
+/* Whole track has to be decoded, otherwise counts are of a partial read */
+static int decode(drmp3 *mp3) {
+	static int16_t pcm[STREAM_BENCH_DECODE_FRAMES * 2];
+	drmp3_uint64 frames_read;
+	uint64_t frames_decoded = 0;
+
+	while ((frames_read = drmp3_read_pcm_frames_s16(mp3, STREAM_BENCH_DECODE_FRAMES, pcm)) > 0) {
+		frames_decoded += frames_read;
+	}
+	drmp3_uninit(mp3);
+	return (frames_decoded == ((uint64_t)STREAM_BENCH_FRAMES * STREAM_BENCH_FRAME_SAMPLES)) ? 0 : -1;
+}
+
+static int run(const char *name, DWORD cluster_size, bool use_stream) {
+	static stream_t stream;
+	FATFS fatfs;
+	FIL file;
+	drmp3 mp3;
+	int ret = -1;
+
+	if (f_mount(&fatfs, "", 1) != FR_OK) {
+		return -1;
+	}
+
+	/* Opening reads the directory, only the decoding is counted, like on the device */
+	if (use_stream) {
+		if (stream_open(&stream, STREAM_BENCH_FILE) == 0) {
+			memset(&stats, 0, sizeof(stats));
+			if (drmp3_init(&mp3, stream_read_callback, stream_seek_callback, &stream, NULL)) {
+				ret = decode(&mp3);
+			}
+			stream_close(&stream);
+		}
+	}
+	else {
+		if (f_open(&file, STREAM_BENCH_FILE, FA_READ) == FR_OK) {
+			memset(&stats, 0, sizeof(stats));
+			if (drmp3_init(&mp3, file_read, file_seek, &file, NULL)) {
+				ret = decode(&mp3);
+			}
+			f_close(&file);
+		}
+	}
+	f_mount(NULL, "", 0);
+
+	printf("%-8s %5lu KiB %10lu %10lu %10lu %12.2f%s\n", name, (unsigned long)(cluster_size / 1024),
+		   (unsigned long)stats.read_commands, (unsigned long)stats.single_reads, (unsigned long)stats.read_sectors,
+		   (stats.read_commands > 0) ? ((double)stats.read_sectors / stats.read_commands) : 0.0, (ret == 0) ? "" : " FAIL");
+	return ret;
+}
+
+int main(int argc, char **argv) {
+	static const DWORD cluster_sizes[] = {4096, 32768};
+	int failures = 0;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <scratch image path>\n", argv[0]);
+		return 1;
+	}
+
+	printf("Decoding %d frames (%d bytes)\n", STREAM_BENCH_FRAMES, STREAM_BENCH_FRAMES * STREAM_BENCH_FRAME_SIZE);
+	printf("%-8s %9s %10s %10s %10s %12s\n", "Reader", "Cluster", "Commands", "Single", "Sectors", "Sectors/cmd");
+	for (size_t i = 0; i < (sizeof(cluster_sizes) / sizeof(cluster_sizes[0])); ++i) {
+		if (make_image(argv[1], cluster_sizes[i]) != 0) {
+			fprintf(stderr, "Failed to create '%s'\n", argv[1]);
+			return 1;
+		}
+
+		if (image_diskio_open(argv[1]) != 0) {
+			fprintf(stderr, "Failed to open '%s'\n", argv[1]);
+			return 1;
+		}
+		if (run("direct", cluster_sizes[i], false) != 0) {
+			failures++;
+		}
+		if (run("stream", cluster_sizes[i], true) != 0) {
+			failures++;
+		}
+		image_diskio_close();
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+/* Host build - GPIO port and timer of the display io wrapper are plain structs in RAM */
+#ifndef STM32F4XX_HAL_H_
+#define STM32F4XX_HAL_H_
+
+#include <stdint.h>
+
+typedef struct {
+	volatile uint32_t BSRR;
+} GPIO_TypeDef;
+
+typedef enum {
+	GPIO_PIN_RESET,
+	GPIO_PIN_SET
+} GPIO_PinState;
+
+typedef struct {
+	volatile uint32_t ARR;
+	volatile uint32_t CNT;
+	volatile uint32_t CR1;
+	volatile uint32_t SR;
+	volatile uint32_t DIER;
+} TIM_TypeDef;
+
+typedef struct {
+	TIM_TypeDef *Instance;
+} TIM_HandleTypeDef;
+
+extern GPIO_TypeDef bench_gpiod;
+#define GPIOD (&bench_gpiod)
+
+#define GPIO_PIN_0 ((uint16_t)0x0001)
+#define GPIO_PIN_1 ((uint16_t)0x0002)
+#define GPIO_PIN_2 ((uint16_t)0x0004)
+#define GPIO_PIN_3 ((uint16_t)0x0008)
+#define GPIO_PIN_6 ((uint16_t)0x0040)
+#define GPIO_PIN_7 ((uint16_t)0x0080)
+
+#define TIM_FLAG_UPDATE 0x0001
+#define TIM_IT_UPDATE 0x0001
+
+/* Same register accesses as the HAL macros */
+#define __HAL_TIM_SET_AUTORELOAD(handle, value) ((handle)->Instance->ARR = (value))
+#define __HAL_TIM_SET_COUNTER(handle, value) ((handle)->Instance->CNT = (value))
+#define __HAL_TIM_ENABLE(handle) ((handle)->Instance->CR1 |= 0x0001)
+#define __HAL_TIM_CLEAR_FLAG(handle, flag) ((handle)->Instance->SR = ~(flag))
+#define __HAL_TIM_ENABLE_IT(handle, it) ((handle)->Instance->DIER |= (it))
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+
+#endif /* STM32F4XX_HAL_H_ */
@@ -0,0 +1,283 @@
+/*
+ * hd44780_emulator.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "hd44780_emulator.h"
+#include <string.h>
+#include <errno.h>
+
+#define EMULATOR_COLUMNS 20
+#define EMULATOR_ROWS 2
+#define EMULATOR_LINE_SIZE 0x28 // Each line of two-line display has 40 bytes of DDRAM
+#define EMULATOR_SECOND_LINE_ADDR 0x40
+
+/* Execution times at 270kHz oscillator (HD44780 datasheet, Table 6, p. 24) */
+#define EMULATOR_CLEAR_TIME 1520 // us, clear display and return home
+#define EMULATOR_EXECUTION_TIME 37 // us, all the other instructions and data writes
+#define EMULATOR_MIN_PULSE_TIME 1 // us, at least 450ns, emulator's time resolution is 1us
+
+#define EMULATOR_TIMER_IDLE -1
+
+typedef struct {
+	/* Controller state */
+	uint8_t ddram[EMULATOR_DDRAM_SIZE];
+	uint8_t cgram[EMULATOR_CGRAM_SIZE];
+	uint8_t address_counter;
+	bool cgram_selected; // Data goes to CGRAM, set by last address instruction
+	bool increment; // Entry mode I/D flag
+	bool display_shift; // Entry mode S flag
+	int shift; // Display shift in characters, positive to the left
+	bool four_bit; // Interface width, controller starts in 8-bit mode
+	bool upper_nibble_latched; // In 4-bit mode, the first half of a byte was latched
+	uint8_t latched_byte;
+
+	/* Bus state */
+	HD44780_pin_state_t pins[HD44780_PIN_NUM];
+	uint64_t time; // Emulated time, us
+	uint64_t busy_until; // Time the last instruction finishes executing
+	uint64_t enable_rise_time;
+	int32_t timer; // Time left to timer expiry, EMULATOR_TIMER_IDLE if not running
+
+	emulator_stats_t stats;
+	HD44780_io_t io;
+} emulator_ctx_t;
+
+static emulator_ctx_t ctx;
+
+static uint8_t ddram_index(uint8_t address) {
+	return address & (EMULATOR_DDRAM_SIZE - 1);
+}
+
+/* Moves address counter the way controller does - DDRAM lines wrap into each other, CGRAM wraps at its end */
+static void move_address_counter(void) {
+	if (ctx.cgram_selected) {
+		ctx.address_counter = (ctx.address_counter + (ctx.increment ? 1 : -1)) & (EMULATOR_CGRAM_SIZE - 1);
+		return;
+	}
+
+	if (ctx.increment) {
+		if (ctx.address_counter == (EMULATOR_LINE_SIZE - 1)) {
+			ctx.address_counter = EMULATOR_SECOND_LINE_ADDR;
+		}
+		else if (ctx.address_counter == (EMULATOR_SECOND_LINE_ADDR + EMULATOR_LINE_SIZE - 1)) {
+			ctx.address_counter = 0;
+		}
+		else {
+			ctx.address_counter++;
+		}
+	}
+	else {
+		if (ctx.address_counter == 0) {
+			ctx.address_counter = EMULATOR_SECOND_LINE_ADDR + EMULATOR_LINE_SIZE - 1;
+		}
+		else if (ctx.address_counter == EMULATOR_SECOND_LINE_ADDR) {
+			ctx.address_counter = EMULATOR_LINE_SIZE - 1;
+		}
+		else {
+			ctx.address_counter--;
+		}
+	}
+}
+
+static uint32_t execute_instruction(uint8_t instruction) {
+	ctx.stats.instructions++;
+
+	/* Not an instruction, driver sends it as upper half of 0x03 and 0x02 while still in 8-bit mode during init */
+	if (instruction == 0x00) {
+		return 0;
+	}
+
+	if (instruction & HD44780_SET_DDRAM_ADDR_CMD) {
+		ctx.address_counter = instruction & (EMULATOR_DDRAM_SIZE - 1);
+		ctx.cgram_selected = false;
+	}
+	else if (instruction & HD44780_SET_CGRAM_ADDR_CMD) {
+		ctx.address_counter = instruction & (EMULATOR_CGRAM_SIZE - 1);
+		ctx.cgram_selected = true;
+	}
+	else if (instruction & HD44780_FUNCTION_SET_CMD) {
+		ctx.four_bit = !(instruction & 0x10); // DL flag
+	}
+	else if (instruction & HD44780_CURSOR_OR_DISP_SHIFT_MODE_CMD) {
+		if (instruction & 0x08) { // S/C flag - shift display, not the cursor
+			ctx.shift += (instruction & 0x04) ? -1 : 1; // R/L flag
+		}
+		else {
+			move_address_counter();
+		}
+	}
+	else if (instruction & HD44780_DISPLAY_ON_OFF_CMD) {
+		/* Display and cursor visibility don't change contents */
+	}
+	else if (instruction & HD44780_ENTRY_MODE_SET_CMD) {
+		ctx.increment = (instruction & HD44780_INCREASE_CURSOR_ON) != 0;
+		ctx.display_shift = (instruction & HD44780_DISPLAY_SCROLL_ON) != 0;
+	}
+	else if (instruction & 0x02) { // Return home
+		ctx.address_counter = 0;
+		ctx.cgram_selected = false;
+		ctx.shift = 0;
+		return EMULATOR_CLEAR_TIME;
+	}
+	else if (instruction & HD44780_CLEAR_DISPLAY_CMD) {
+		memset(ctx.ddram, ' ', sizeof(ctx.ddram));
+		ctx.address_counter = 0;
+		ctx.cgram_selected = false;
+		ctx.increment = true;
+		ctx.shift = 0;
+		return EMULATOR_CLEAR_TIME;
+	}
+
+	return EMULATOR_EXECUTION_TIME;
+}
+
+static uint32_t write_data(uint8_t data) {
+	ctx.stats.characters++;
+
+	if (ctx.cgram_selected) {
+		ctx.cgram[ctx.address_counter] = data;
+	}
+	else {
+		ctx.ddram[ddram_index(ctx.address_counter)] = data;
+		if (ctx.display_shift) {
+			ctx.shift += ctx.increment ? 1 : -1;
+		}
+	}
+	move_address_counter();
+
+	return EMULATOR_EXECUTION_TIME;
+}
+
+/* Controller latches the bus on falling edge of enable */
+static void latch(void) {
+	const uint8_t nibble = (ctx.pins[HD44780_PIN_D7] << 3) | (ctx.pins[HD44780_PIN_D6] << 2) |
+						   (ctx.pins[HD44780_PIN_D5] << 1) | (ctx.pins[HD44780_PIN_D4] << 0);
+	uint8_t byte;
+
+	ctx.stats.enable_pulses++;
+	if ((ctx.time - ctx.enable_rise_time) < EMULATOR_MIN_PULSE_TIME) {
+		ctx.stats.timing_violations++;
+	}
+
+	/* Second half of a byte belongs to the same write, only the beginning of a new one has to wait */
+	if (!ctx.upper_nibble_latched && (ctx.time < ctx.busy_until)) {
+		ctx.stats.timing_violations++;
+	}
+
+	if (ctx.four_bit) {
+		if (!ctx.upper_nibble_latched) {
+			ctx.latched_byte = nibble << 4;
+			ctx.upper_nibble_latched = true;
+			return;
+		}
+		byte = ctx.latched_byte | nibble;
+		ctx.upper_nibble_latched = false;
+	}
+	else {
+		/* D0-D3 aren't connected, they read as low */
+		byte = nibble << 4;
+	}
+
+	const uint32_t execution_time = (ctx.pins[HD44780_PIN_RS] == HD44780_HIGH) ? write_data(byte) : execute_instruction(byte);
+	ctx.busy_until = ctx.time + execution_time;
+}
+
+static void set_pin_state(HD44780_pin_t pin, HD44780_pin_state_t state) {
+	ctx.stats.pin_writes++;
+
+	if (pin == HD44780_PIN_E) {
+		if ((ctx.pins[pin] == HD44780_LOW) && (state == HD44780_HIGH)) {
+			ctx.enable_rise_time = ctx.time;
+		}
+		else if ((ctx.pins[pin] == HD44780_HIGH) && (state == HD44780_LOW)) {
+			ctx.pins[pin] = state;
+			latch();
+			return;
+		}
+	}
+
+	ctx.pins[pin] = state;
+}
+
+static void write_bus(uint8_t nibble, HD44780_pin_state_t rs_state) {
+	ctx.stats.pin_writes++;
+
+	ctx.pins[HD44780_PIN_RS] = rs_state;
+	ctx.pins[HD44780_PIN_D4] = (nibble >> 0) & 1;
+	ctx.pins[HD44780_PIN_D5] = (nibble >> 1) & 1;
+	ctx.pins[HD44780_PIN_D6] = (nibble >> 2) & 1;
+	ctx.pins[HD44780_PIN_D7] = (nibble >> 3) & 1;
+}
+
+static void delay_us(uint16_t us) {
+	ctx.time += us;
+	ctx.stats.bus_time += us;
+}
+
+static void start_timer(uint16_t us) {
+	ctx.timer = us;
+}
+
+void emulator_reset(bool queued) {
+	memset(&ctx, 0, sizeof(ctx));
+
+	/* DDRAM content is undefined after power on, spaces make dumps readable */
+	memset(ctx.ddram, ' ', sizeof(ctx.ddram));
+	ctx.increment = true;
+	ctx.timer = EMULATOR_TIMER_IDLE;
+
+	ctx.io.set_pin_state = set_pin_state;
+	ctx.io.delay_us = delay_us;
+	ctx.io.write_bus = write_bus;
+	ctx.io.start_timer = queued ? start_timer : NULL;
+}
+
+HD44780_io_t *emulator_get_io(void) {
+	return &ctx.io;
+}
+
+void emulator_run(void) {
+	while (ctx.timer != EMULATOR_TIMER_IDLE) {
+		const uint16_t us = ctx.timer;
+
+		ctx.timer = EMULATOR_TIMER_IDLE;
+		ctx.time += us;
+		ctx.stats.bus_time += us;
+		ctx.stats.timer_callbacks++;
+		HD44780_timer_callback();
+	}
+}
+
+void emulator_get_stats(emulator_stats_t *stats) {
+	*stats = ctx.stats;
+}
+
+void emulator_reset_stats(void) {
+	memset(&ctx.stats, 0, sizeof(ctx.stats));
+}
+
+int emulator_get_line(size_t row, char *buffer, size_t size) {
+	/* Sanity check */
+	if ((row >= EMULATOR_ROWS) || (buffer == NULL) || (size < (EMULATOR_COLUMNS + 1))) {
+		return -EINVAL;
+	}
+
+	/* Each line shows its own 40 characters, display shift moves the window over them */
+	const uint8_t line_start = row * EMULATOR_SECOND_LINE_ADDR;
+	for (size_t column = 0; column < EMULATOR_COLUMNS; ++column) {
+		int offset = ((int)column + ctx.shift) % EMULATOR_LINE_SIZE;
+		if (offset < 0) {
+			offset += EMULATOR_LINE_SIZE;
+		}
+		buffer[column] = ctx.ddram[line_start + offset];
+	}
+	buffer[EMULATOR_COLUMNS] = '\0';
+
+	return 0;
+}
+
+const uint8_t *emulator_get_cgram(void) {
+	return ctx.cgram;
+}
@@ -0,0 +1,47 @@
+/*
+ * hd44780_emulator.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+
+#ifndef HD44780_EMULATOR_H_
+#define HD44780_EMULATOR_H_
+
+#include "HD44780.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define EMULATOR_DDRAM_SIZE 0x80
+#define EMULATOR_CGRAM_SIZE 0x40
+
+/* Bus activity since last emulator_reset_stats() */
+typedef struct {
+	uint64_t bus_time; // Emulated time the bus was driven for, in us - what blocking driver spends in main loop
+	uint32_t instructions;
+	uint32_t characters; // Bytes written to DDRAM or CGRAM
+	uint32_t enable_pulses;
+	uint32_t pin_writes; // Calls of set_pin_state and write_bus
+	uint32_t timer_callbacks;
+	uint32_t timing_violations; // Writes started before previous one was executed or too short enable pulses
+} emulator_stats_t;
+
+/* Puts the controller in power-on state. Queued mode provides start_timer, so writes go through the driver's
+ * queue and are clocked out by emulator_run(), otherwise the driver writes in place using delay_us. */
+void emulator_reset(bool queued);
+
+HD44780_io_t *emulator_get_io(void);
+
+/* Calls timer callbacks until the driver's queue is drained, no-op in blocking mode */
+void emulator_run(void);
+
+void emulator_get_stats(emulator_stats_t *stats);
+void emulator_reset_stats(void);
+
+/* Copies visible characters of the row (indexed from 0) of 20x2 display, null-terminated */
+int emulator_get_line(size_t row, char *buffer, size_t size);
+
+const uint8_t *emulator_get_cgram(void);
+
+#endif /* HD44780_EMULATOR_H_ */
@@ -0,0 +1,204 @@
+/*
+ * main.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "hd44780_emulator.h"
+#include "display.h"
+#include <stdio.h>
+#include <string.h>
+
+#define EMULATOR_SCROLL_DELAY 250 // ms, same as GUI_SCROLL_DELAY
+#define EMULATOR_SCROLL_STEPS 20
+#define EMULATOR_BAR_MAX 100
+
+typedef struct {
+	const char *name;
+	void (*run)(void);
+	const char *expected[DISPLAY_LINE_NUM]; // Screen after the operation, NULL if not checked
+} emulator_operation_t;
+
+static const uint8_t play_glyph[DISPLAY_GLYPH_HEIGHT] = {
+	0b00000, 0b01000, 0b01100, 0b01110, 0b01100, 0b01000, 0b00000, 0b00000
+};
+
+static uint32_t tick;
+static display_bar_t bar;
+static uint32_t progress;
+
+uint32_t HAL_GetTick(void) {
+	return tick;
+}
+
+/* Newlib extension used by HD44780_write_integer(), not available in glibc */
+char *itoa(int value, char *buffer, int base) {
+	(void)base;
+	sprintf(buffer, "%d", value);
+	return buffer;
+}
+
+/* Advances time enough for every line to be due and renders. Queue is drained after each frame, as timer
+ * interrupt would do meanwhile - otherwise the driver would wait for space in the queue forever. */
+static void render(void) {
+	tick += EMULATOR_SCROLL_DELAY;
+	display_task();
+	emulator_run();
+}
+
+static void op_init(void) {
+	static HD44780_config_t config = {
+		.type = HD44780_DISPLAY_20x2,
+		.entry_mode_flags = HD44780_INCREASE_CURSOR_ON,
+		.on_off_flags = HD44780_DISPLAY_ON
+	};
+
+	config.io = emulator_get_io();
+	HD44780_init(&config);
+	display_init();
+}
+
+static void op_explorer(void) {
+	display_set_text_sync("01 - Intro.mp3", "02 - Theme.mp3", EMULATOR_SCROLL_DELAY);
+	render();
+}
+
+static void op_explorer_down(void) {
+	display_set_text_sync("02 - Theme.mp3", "03 - Outro.mp3", EMULATOR_SCROLL_DELAY);
+	render();
+}
+
+static void op_scroll(void) {
+	display_set_text_sync("A very long directory name", "Another long name of a file.mp3", EMULATOR_SCROLL_DELAY);
+	for (size_t i = 0; i < EMULATOR_SCROLL_STEPS; ++i) {
+		render();
+	}
+}
+
+/* Playback view acquires state glyph on each render, the way GUI does */
+static void render_playback_time(const char *time) {
+	static int state_glyph = -1;
+	char line[DISPLAY_LINE_LENGTH + 1];
+
+	const int code = display_acquire_glyph(play_glyph);
+	if (state_glyph >= 0) {
+		display_release_glyph(state_glyph);
+	}
+	state_glyph = code;
+
+	snprintf(line, sizeof(line), "%c   %s", code, time);
+	display_set_text(line, 2, EMULATOR_SCROLL_DELAY);
+}
+
+static void op_playback(void) {
+	display_set_text("02 - Theme.mp3", 1, EMULATOR_SCROLL_DELAY);
+	render_playback_time("00:00/03:15");
+	render();
+}
+
+/* Glyph is already in CGRAM, only the changed digit is sent */
+static void op_playback_time(void) {
+	render_playback_time("00:01/03:15");
+	render();
+}
+
+static void op_volume(void) {
+	char line[DISPLAY_LINE_LENGTH + 1];
+
+	display_render_bar(&bar, line, DISPLAY_LINE_LENGTH, 70, EMULATOR_BAR_MAX);
+	display_set_text_sync("Volume level: -6dB", line, EMULATOR_SCROLL_DELAY);
+	render();
+}
+
+static void render_progress(void) {
+	char line[DISPLAY_LINE_LENGTH + 1];
+
+	display_render_bar(&bar, line, DISPLAY_LINE_LENGTH, progress, EMULATOR_BAR_MAX);
+	display_set_text(line, 2, EMULATOR_SCROLL_DELAY);
+	render();
+}
+
+/* Goes through all the partial glyphs, loading each of them once */
+static void op_progress(void) {
+	for (progress = 71; progress <= 75; ++progress) {
+		render_progress();
+	}
+}
+
+/* Glyphs are already in CGRAM, only the boundary cell is sent */
+static void op_progress_step(void) {
+	progress = 76;
+	render_progress();
+}
+
+static const emulator_operation_t operations[] = {
+	{"init", op_init, {"                    ", "                    "}},
+	{"explorer", op_explorer, {"01 - Intro.mp3      ", "02 - Theme.mp3      "}},
+	{"explorer down", op_explorer_down, {"02 - Theme.mp3      ", "03 - Outro.mp3      "}},
+	{"scroll x20", op_scroll, {"ry name       A very", "f a file.mp3  Anothe"}},
+	{"playback", op_playback, {"02 - Theme.mp3      ", "\x08   00:00/03:15     "}},
+	{"playback time", op_playback_time, {"02 - Theme.mp3      ", "\x08   00:01/03:15     "}},
+	{"volume", op_volume, {"Volume level: -6dB  ", "\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF      "}},
+	{"progress x5", op_progress, {"Volume level: -6dB  ", "\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF     "}},
+	{"progress step", op_progress_step, {"Volume level: -6dB  ", "\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\x09    "}},
+};
+
+/* Custom and non-ASCII glyphs are shown as '#' */
+static void print_line(const char *line) {
+	putchar('|');
+	for (const char *c = line; *c != '\0'; ++c) {
+		putchar(((*c >= ' ') && (*c <= '~')) ? *c : '#');
+	}
+	putchar('|');
+}
+
+static int run(bool queued) {
+	int failures = 0;
+
+	printf("%s driver\n", queued ? "Queued (timer-driven)" : "Blocking");
+	printf("%-14s %9s %6s %6s %6s %6s %5s\n", "operation", "bus [us]", "instr", "chars", "pins", "irqs", "viol");
+
+	tick = 0;
+	progress = 0;
+	emulator_reset(queued);
+	for (size_t i = 0; i < (sizeof(operations) / sizeof(operations[0])); ++i) {
+		const emulator_operation_t *op = &operations[i];
+		emulator_stats_t stats;
+		char line[DISPLAY_LINE_LENGTH + 1];
+		bool match = true;
+
+		emulator_reset_stats();
+		op->run();
+		emulator_run();
+		emulator_get_stats(&stats);
+
+		printf("%-14s %9llu %6u %6u %6u %6u %5u  ", op->name, (unsigned long long)stats.bus_time, stats.instructions,
+			   stats.characters, stats.pin_writes, stats.timer_callbacks, stats.timing_violations);
+
+		for (size_t row = 0; row < DISPLAY_LINE_NUM; ++row) {
+			emulator_get_line(row, line, sizeof(line));
+			print_line(line);
+			if ((op->expected[row] != NULL) && (strcmp(line, op->expected[row]) != 0)) {
+				match = false;
+			}
+		}
+
+		if (!match || (stats.timing_violations > 0)) {
+			printf(" FAIL");
+			failures++;
+		}
+		putchar('\n');
+	}
+	putchar('\n');
+
+	return failures;
+}
+
+int main(void) {
+	int failures = 0;
+
+	failures += run(false);
+	failures += run(true);
+
+	return (failures == 0) ? 0 : 1;
+}
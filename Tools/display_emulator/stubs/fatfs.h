@@ -0,0 +1,2 @@
+/* Host build - display only needs _MAX_LFN from FatFs configuration of the target */
+#include "ffconf.h"
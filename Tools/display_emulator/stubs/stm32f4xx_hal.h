@@ -0,0 +1,4 @@
+/* Host build - display only needs tick, provided by the emulator's main */
+#include <stdint.h>
+
+uint32_t HAL_GetTick(void);
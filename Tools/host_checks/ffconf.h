@@ -0,0 +1,5 @@
+/* Host build - target configuration with f_mkfs() enabled, checks format their scratch images themselves */
+#include "../../FATFS/Target/ffconf.h"
+
+#undef _USE_MKFS
+#define _USE_MKFS 1
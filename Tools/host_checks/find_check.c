@@ -0,0 +1,148 @@
+/*
+ * find_check.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "image_diskio.h"
+#include "dir.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FIND_CHECK_IMAGE_SIZE (4 * 1024 * 1024)
+
+typedef struct {
+	const char *dir;
+	const char *prefix;
+	const char *expected; // Name of entry found
+} find_case_t;
+
+/* Numbers aren't padded in the first directory, so "2" sorts between "1" and "10" */
+static const char *const unpadded[] = {"1 - One.mp3", "2 - Two.mp3", "10 - Ten.mp3", "11 - Eleven.mp3", "Intro.mp3", NULL};
+static const char *const no_one[] = {"2 - Two.mp3", "10 - Ten.mp3", "11 - Eleven.mp3", NULL};
+static const char *const padded[] = {"01 - One.mp3", "02 - Two.mp3", "10 - Ten.mp3", "11 - Eleven.mp3", NULL};
+static const char *const mixed[] = {"Disc 1", "Disc 2", "Disc 10", "Bonus.mp3", "Track 1.mp3", "Track 12.mp3", NULL};
+
+static const find_case_t cases[] = {
+	{"unpadded", "1", "1 - One.mp3"},
+	{"unpadded", "2", "2 - Two.mp3"},
+	{"unpadded", "10", "10 - Ten.mp3"},
+	{"unpadded", "11", "11 - Eleven.mp3"},
+	{"unpadded", "1 ", "1 - One.mp3"},
+	{"unpadded", "3", "10 - Ten.mp3"}, // No match, closest following one
+	{"unpadded", "I", "Intro.mp3"},
+	{"no_one", "1", "10 - Ten.mp3"}, // Longer number starting with the digit, not the "2" following "1"
+	{"no_one", "11", "11 - Eleven.mp3"},
+	{"no_one", "2", "2 - Two.mp3"},
+	{"padded", "0", "01 - One.mp3"}, // Leading zeros don't change the value
+	{"padded", "01", "01 - One.mp3"},
+	{"padded", "02", "02 - Two.mp3"},
+	{"padded", "1", "01 - One.mp3"},
+	{"padded", "11", "11 - Eleven.mp3"},
+	{"mixed", "Disc 1", "Disc 1"},
+	{"mixed", "Disc 10", "Disc 10"},
+	{"mixed", "Track 1", "Track 1.mp3"},
+	{"mixed", "Track 12", "Track 12.mp3"},
+	{"mixed", "B", "Bonus.mp3"}, // Not a directory, found among files
+};
+
+static int make_dir(const char *name, const char *const *entries) {
+	char path[64];
+
+	snprintf(path, sizeof(path), "/%s", name);
+	if (f_mkdir(path) != FR_OK) {
+		return -1;
+	}
+
+	for (size_t i = 0; entries[i] != NULL; ++i) {
+		snprintf(path, sizeof(path), "/%s/%s", name, entries[i]);
+		if (strstr(entries[i], ".mp3") == NULL) {
+			if (f_mkdir(path) != FR_OK) {
+				return -1;
+			}
+			continue;
+		}
+
+		FIL file;
+		if (f_open(&file, path, FA_CREATE_NEW | FA_WRITE) != FR_OK) {
+			return -1;
+		}
+		f_close(&file);
+	}
+	return 0;
+}
+
+static int make_image(const char *path) {
+	static BYTE work[4096];
+	FATFS fatfs;
+
+	FILE *image = fopen(path, "wb");
+	if ((image == NULL) || (ftruncate(fileno(image), FIND_CHECK_IMAGE_SIZE) != 0)) {
+		return -1;
+	}
+	fclose(image);
+
+	if ((image_diskio_open(path) != 0) || (f_mkfs("", FM_ANY, 0, work, sizeof(work)) != FR_OK) ||
+		(f_mount(&fatfs, "", 1) != FR_OK)) {
+		return -1;
+	}
+
+	const int ret = ((make_dir("unpadded", unpadded) == 0) && (make_dir("no_one", no_one) == 0) &&
+					 (make_dir("padded", padded) == 0) &&
+					 (make_dir("mixed", mixed) == 0)) ? 0 : -1;
+
+	f_mount(NULL, "", 0);
+	image_diskio_close();
+	return ret;
+}
+
+static int run_case(const find_case_t *c) {
+	dir_init("");
+	if (dir_enter(c->dir) != 0) {
+		return -1;
+	}
+
+	dir_list_t *list = dir_list();
+	const dir_entry_t entry = dir_find(list, c->prefix);
+	const dir_info_t *info = (entry != DIR_ENTRY_INVALID) ? dir_get_info(list, entry) : NULL;
+	const char *found = (info != NULL) ? info->name : "(none)";
+	const int ret = (strcmp(found, c->expected) == 0) ? 0 : -1;
+
+	printf("%-9s %-9s %-16s%s\n", c->dir, c->prefix, found, (ret == 0) ? "" : " FAIL");
+
+	dir_list_free(list);
+	return ret;
+}
+
+int main(int argc, char **argv) {
+	FATFS fatfs;
+	int failures = 0;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <scratch image path>\n", argv[0]);
+		return 1;
+	}
+
+	if (make_image(argv[1]) != 0) {
+		fprintf(stderr, "Failed to create '%s'\n", argv[1]);
+		return 1;
+	}
+
+	/* Listings are indexed when first read, which makes them searchable */
+	if ((image_diskio_open(argv[1]) != 0) || (f_mount(&fatfs, "", 1) != FR_OK)) {
+		fprintf(stderr, "Failed to mount '%s'\n", argv[1]);
+		return 1;
+	}
+
+	for (size_t i = 0; i < (sizeof(cases) / sizeof(cases[0])); ++i) {
+		if (run_case(&cases[i]) != 0) {
+			failures++;
+		}
+	}
+
+	f_mount(NULL, "", 0);
+	image_diskio_close();
+
+	return (failures == 0) ? 0 : 1;
+}
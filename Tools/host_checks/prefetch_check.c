@@ -0,0 +1,215 @@
+/*
+ * prefetch_check.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "image_diskio.h"
+#include "dir.h"
+#include "diskio.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PREFETCH_CHECK_IMAGE_SIZE (16 * 1024 * 1024)
+#define PREFETCH_CHECK_ENTRIES 1000 // Enough for runs to be merged in more than one pass
+#define PREFETCH_CHECK_MAX_STEP_SECTORS 32 // Per step, whole build takes hundreds
+#define PREFETCH_CHECK_PARTIAL_STEPS 10 // Steps done before prefetch is interrupted
+
+typedef enum {
+	PREFETCH_COMPLETE, // Prefetched, then entered
+	PREFETCH_ENTERED, // Entered while prefetch is in progress
+	PREFETCH_REPLACED // Another directory prefetched while prefetch is in progress
+} prefetch_mode_t;
+
+typedef struct {
+	const char *dir;
+	prefetch_mode_t mode;
+} prefetch_case_t;
+
+typedef struct {
+	uint32_t sectors; // Read or written since the counter was cleared
+} prefetch_check_ctx_t;
+
+static prefetch_check_ctx_t ctx;
+
+static const prefetch_case_t cases[] = {
+	{"complete", PREFETCH_COMPLETE},
+	{"entered", PREFETCH_ENTERED},
+	{"replaced", PREFETCH_REPLACED}
+};
+
+DRESULT __real_disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count);
+DRESULT __real_disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count);
+
+DRESULT __wrap_disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count) {
+	ctx.sectors += count;
+	return __real_disk_read(pdrv, buff, sector, count);
+}
+
+DRESULT __wrap_disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count) {
+	ctx.sectors += count;
+	return __real_disk_write(pdrv, buff, sector, count);
+}
+
+/* Created in reverse order, so that the listing has to be sorted */
+static int make_dir(const char *name) {
+	char path[64];
+
+	snprintf(path, sizeof(path), "/%s", name);
+	if (f_mkdir(path) != FR_OK) {
+		return -1;
+	}
+
+	for (size_t i = PREFETCH_CHECK_ENTRIES; i-- > 0;) {
+		FIL file;
+
+		snprintf(path, sizeof(path), "/%s/Track %04u - Title.mp3", name, (unsigned int)i);
+		if (f_open(&file, path, FA_CREATE_NEW | FA_WRITE) != FR_OK) {
+			return -1;
+		}
+		f_close(&file);
+	}
+	return 0;
+}
+
+static int make_image(const char *path) {
+	static BYTE work[4096];
+	FATFS fatfs;
+	int ret = 0;
+
+	FILE *image = fopen(path, "wb");
+	if ((image == NULL) || (ftruncate(fileno(image), PREFETCH_CHECK_IMAGE_SIZE) != 0)) {
+		return -1;
+	}
+	fclose(image);
+
+	if ((image_diskio_open(path) != 0) || (f_mkfs("", FM_ANY, 0, work, sizeof(work)) != FR_OK) ||
+		(f_mount(&fatfs, "", 1) != FR_OK)) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < (sizeof(cases) / sizeof(cases[0])); ++i) {
+		if (make_dir(cases[i].dir) != 0) {
+			ret = -1;
+		}
+	}
+	if (make_dir("other") != 0) {
+		ret = -1;
+	}
+
+	f_mount(NULL, "", 0);
+	image_diskio_close();
+	return ret;
+}
+
+/* Checks number and order of entries and that no temporary file of the build is left */
+static int check_list(dir_list_t *list) {
+	char expected[64];
+	FILINFO fno;
+
+	if (dir_list_size(list) != PREFETCH_CHECK_ENTRIES) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < PREFETCH_CHECK_ENTRIES; ++i) {
+		const dir_info_t *info = dir_get_info(list, i);
+		snprintf(expected, sizeof(expected), "Track %04u - Title.mp3", (unsigned int)i);
+		if ((info == NULL) || (strcmp(info->name, expected) != 0)) {
+			return -1;
+		}
+	}
+
+	return ((f_stat("/" DIR_CACHE_DIR_NAME "/run0.tmp", &fno) == FR_NO_FILE) &&
+			(f_stat("/" DIR_CACHE_DIR_NAME "/run1.tmp", &fno) == FR_NO_FILE)) ? 0 : -1;
+}
+
+static int run_case(const prefetch_case_t *c) {
+	uint32_t steps = 0;
+	uint32_t max_sectors = 0;
+	int ret = 0;
+
+	dir_init("");
+	if (dir_prefetch(c->dir) != 0) {
+		return -1;
+	}
+
+	while (1) {
+		if ((c->mode != PREFETCH_COMPLETE) && (steps == PREFETCH_CHECK_PARTIAL_STEPS)) {
+			break;
+		}
+
+		ctx.sectors = 0;
+		const int step = dir_prefetch_step();
+		if (step < 0) {
+			ret = -1;
+		}
+		if (step <= 0) {
+			break;
+		}
+
+		steps++;
+		if (ctx.sectors > max_sectors) {
+			max_sectors = ctx.sectors;
+		}
+	}
+
+	/* Build left behind has to be cleaned up */
+	if (c->mode == PREFETCH_REPLACED) {
+		if (dir_prefetch("other") != 0) {
+			ret = -1;
+		}
+		dir_list_free(dir_list_path("/other"));
+	}
+
+	/* Whatever is left of the build is done by listing it */
+	ctx.sectors = 0;
+	if (dir_enter(c->dir) != 0) {
+		return -1;
+	}
+	dir_list_t *list = dir_list();
+	const uint32_t list_sectors = ctx.sectors;
+
+	if ((check_list(list) != 0) || (max_sectors > PREFETCH_CHECK_MAX_STEP_SECTORS) ||
+		((c->mode == PREFETCH_COMPLETE) && (list_sectors != 0))) {
+		ret = -1;
+	}
+
+	printf("%-9s %6lu %10lu %10lu%s\n", c->dir, (unsigned long)steps, (unsigned long)max_sectors,
+		   (unsigned long)list_sectors, (ret == 0) ? "" : " FAIL");
+
+	dir_list_free(list);
+	return ret;
+}
+
+int main(int argc, char **argv) {
+	FATFS fatfs;
+	int failures = 0;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <scratch image path>\n", argv[0]);
+		return 1;
+	}
+
+	if (make_image(argv[1]) != 0) {
+		fprintf(stderr, "Failed to create '%s'\n", argv[1]);
+		return 1;
+	}
+
+	if ((image_diskio_open(argv[1]) != 0) || (f_mount(&fatfs, "", 1) != FR_OK)) {
+		fprintf(stderr, "Failed to mount '%s'\n", argv[1]);
+		return 1;
+	}
+
+	printf("%-9s %6s %10s %10s\n", "Case", "Steps", "Max/step", "On enter");
+	for (size_t i = 0; i < (sizeof(cases) / sizeof(cases[0])); ++i) {
+		if (run_case(&cases[i]) != 0) {
+			failures++;
+		}
+	}
+
+	f_mount(NULL, "", 0);
+	image_diskio_close();
+
+	return (failures == 0) ? 0 : 1;
+}
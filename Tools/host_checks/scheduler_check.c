@@ -0,0 +1,151 @@
+/*
+ * scheduler_check.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "scheduler.h"
+#include <stdio.h>
+#include <string.h>
+
+#define SCHEDULER_CHECK_NO_EVENT UINT32_MAX
+#define SCHEDULER_CHECK_AUDIO_TIME 2000 // us, decoding half of the buffer
+#define SCHEDULER_CHECK_LIBRARY_STEPS 20 // Steps library task has to do before it runs out of work
+#define SCHEDULER_CHECK_TRACE_SIZE 32
+
+typedef struct {
+	const char *name;
+	uint32_t sd_time; // us, each task takes that long
+	uint32_t gui_time;
+	uint32_t library_step; // us, library yields only between steps
+	uint32_t event_at; // us, when refill becomes pending
+	size_t passes;
+	const char *expected_trace; // Letter of each task run, in order
+	uint32_t expected_latency; // us, worst audio latency
+	uint32_t expected_misses;
+} scheduler_case_t;
+
+typedef struct {
+	uint32_t now; // Fake clock, advanced only by the tasks
+	uint32_t event_at;
+	bool serviced;
+	const scheduler_case_t *current;
+	char trace[SCHEDULER_CHECK_TRACE_SIZE];
+	size_t trace_length;
+} scheduler_check_ctx_t;
+
+static scheduler_check_ctx_t ctx;
+
+static const scheduler_case_t cases[] = {
+	/* Library fills the rest of the pass, up to its budget */
+	{"idle", 100, 3000, 1000, SCHEDULER_CHECK_NO_EVENT, 1, "SGPL", 0, 0},
+	/* Refill pending before GUI is checked again right after SD transfer */
+	{"during sd", 100, 3000, 1000, 50, 1, "SAGPL", 100, 0},
+	/* Worst case redraw delays the refill, but library doesn't get in between */
+	{"during redraw", 100, 15000, 1000, 5000, 1, "SGAPL", 15000, 0},
+	/* Library yields after the step the event came in, refill is the first task of the next pass */
+	{"during library", 100, 3000, 1000, 6000, 2, "SGPLASGPL", 1000, 0},
+	/* Single task stalling longer than the deadline is the only way to miss it */
+	{"stalled redraw", 100, 35000, 1000, 1000, 1, "SGAPL", 35000, 1},
+};
+
+static uint32_t get_ticks(void) {
+	return ctx.now;
+}
+
+static void log_run(char task) {
+	if (ctx.trace_length < (SCHEDULER_CHECK_TRACE_SIZE - 1)) {
+		ctx.trace[ctx.trace_length++] = task;
+	}
+}
+
+static bool audio_ready(void) {
+	return !ctx.serviced && (ctx.now >= ctx.event_at);
+}
+
+static void audio_task(void) {
+	log_run('A');
+	ctx.now += SCHEDULER_CHECK_AUDIO_TIME;
+	ctx.serviced = true;
+}
+
+static void sd_task(void) {
+	log_run('S');
+	ctx.now += ctx.current->sd_time;
+}
+
+static void gui_task(void) {
+	log_run('G');
+	ctx.now += ctx.current->gui_time;
+}
+
+/* No directory being prefetched, nothing to do */
+static void prefetch_task(void) {
+	log_run('P');
+}
+
+static void library_task(void) {
+	log_run('L');
+	for (size_t i = 0; i < SCHEDULER_CHECK_LIBRARY_STEPS; ++i) {
+		ctx.now += ctx.current->library_step;
+		if (scheduler_should_yield()) {
+			break;
+		}
+	}
+}
+
+/* Same table as the firmware, only the tasks are fake */
+static const scheduler_task_t tasks[] = {
+	{"audio", audio_task, audio_ready, SCHEDULER_PRIORITY_AUDIO, 40000, 30000},
+	{"sd", sd_task, NULL, SCHEDULER_PRIORITY_IO, 1000, 0},
+	{"gui", gui_task, NULL, SCHEDULER_PRIORITY_UI, 10000, 0},
+	{"prefetch", prefetch_task, NULL, SCHEDULER_PRIORITY_BACKGROUND, 5000, 0},
+	{"library", library_task, NULL, SCHEDULER_PRIORITY_BACKGROUND, 5000, 0}
+};
+
+static int run_case(const scheduler_case_t *c) {
+	int ids[sizeof(tasks) / sizeof(tasks[0])];
+	scheduler_stats_t audio;
+	scheduler_stats_t gui;
+	scheduler_stats_t library;
+
+	memset(&ctx, 0, sizeof(scheduler_check_ctx_t));
+	ctx.event_at = c->event_at;
+	ctx.current = c;
+
+	scheduler_init(get_ticks, 1);
+	for (size_t i = 0; i < (sizeof(tasks) / sizeof(tasks[0])); ++i) {
+		ids[i] = scheduler_add(&tasks[i]);
+	}
+
+	for (size_t i = 0; i < c->passes; ++i) {
+		scheduler_run();
+	}
+
+	scheduler_get_stats(ids[0], &audio);
+	scheduler_get_stats(ids[2], &gui);
+	scheduler_get_stats(ids[4], &library);
+
+	/* Library never runs past its budget, it yields instead */
+	const int ret = ((strcmp(ctx.trace, c->expected_trace) == 0) && (audio.worst_latency == c->expected_latency) &&
+					 (audio.deadline_misses == c->expected_misses) && (library.overruns == 0) &&
+					 !scheduler_should_yield()) ? 0 : -1;
+
+	printf("%-15s %-10s %8lu %7lu %9lu %10lu%s\n", c->name, ctx.trace, (unsigned long)audio.worst_latency,
+		   (unsigned long)audio.deadline_misses, (unsigned long)gui.overruns, (unsigned long)library.worst_time,
+		   (ret == 0) ? "" : " FAIL");
+	return ret;
+}
+
+int main(void) {
+	int failures = 0;
+
+	printf("%-15s %-10s %8s %7s %9s %10s\n", "Case", "Trace", "Latency", "Misses", "GUI over", "Lib worst");
+	for (size_t i = 0; i < (sizeof(cases) / sizeof(cases[0])); ++i) {
+		if (run_case(&cases[i]) != 0) {
+			failures++;
+		}
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+/*
+ * image_diskio.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#define _FILE_OFFSET_BITS 64
+#include "image_diskio.h"
+#include "ff.h"
+#include "diskio.h"
+#include <stdio.h>
+#include <time.h>
+#include <errno.h>
+
+#define IMAGE_SECTOR_SIZE 512
+
+static FILE *image;
+static DWORD sector_count;
+
+int image_diskio_open(const char *path) {
+	image = fopen(path, "r+b");
+	if (image == NULL) {
+		return -errno;
+	}
+
+	/* Works for block devices too */
+	if (fseeko(image, 0, SEEK_END) != 0) {
+		fclose(image);
+		image = NULL;
+		return -EIO;
+	}
+	sector_count = ftello(image) / IMAGE_SECTOR_SIZE;
+
+	return 0;
+}
+
+void image_diskio_close(void) {
+	if (image != NULL) {
+		fclose(image);
+		image = NULL;
+	}
+}
+
+DSTATUS disk_status(BYTE pdrv) {
+	/* Image is the only drive */
+	if (pdrv > 0) {
+		return STA_NOINIT;
+	}
+	return (image != NULL) ? 0 : STA_NOINIT;
+}
+
+DSTATUS disk_initialize(BYTE pdrv) {
+	return disk_status(pdrv);
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count) {
+	if (pdrv > 0) {
+		return RES_PARERR;
+	}
+
+	if ((fseeko(image, (off_t)sector * IMAGE_SECTOR_SIZE, SEEK_SET) != 0) || (fread(buff, IMAGE_SECTOR_SIZE, count, image) != count)) {
+		return RES_ERROR;
+	}
+	return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count) {
+	if (pdrv > 0) {
+		return RES_PARERR;
+	}
+
+	if ((fseeko(image, (off_t)sector * IMAGE_SECTOR_SIZE, SEEK_SET) != 0) || (fwrite(buff, IMAGE_SECTOR_SIZE, count, image) != count)) {
+		return RES_ERROR;
+	}
+	return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff) {
+	if (pdrv > 0) {
+		return RES_PARERR;
+	}
+
+	switch (cmd) {
+		case CTRL_SYNC:
+			return (fflush(image) == 0) ? RES_OK : RES_ERROR;
+		case GET_SECTOR_COUNT:
+			*(DWORD *)buff = sector_count;
+			return RES_OK;
+		case GET_SECTOR_SIZE:
+			*(WORD *)buff = IMAGE_SECTOR_SIZE;
+			return RES_OK;
+		case GET_BLOCK_SIZE:
+			*(DWORD *)buff = 1;
+			return RES_OK;
+		default:
+			return RES_PARERR;
+	}
+}
+
+DWORD get_fattime(void) {
+	const time_t now = time(NULL);
+	const struct tm *t = localtime(&now);
+
+	return ((DWORD)(t->tm_year - 80) << 25) | ((DWORD)(t->tm_mon + 1) << 21) | ((DWORD)t->tm_mday << 16) |
+		   ((DWORD)t->tm_hour << 11) | ((DWORD)t->tm_min << 5) | ((DWORD)t->tm_sec >> 1);
+}
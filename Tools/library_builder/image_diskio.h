@@ -0,0 +1,15 @@
+/*
+ * image_diskio.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+
+#ifndef IMAGE_DISKIO_H_
+#define IMAGE_DISKIO_H_
+
+/* FatFs disk driver backed by a card image file or a raw block device */
+int image_diskio_open(const char *path);
+void image_diskio_close(void);
+
+#endif /* IMAGE_DISKIO_H_ */
@@ -0,0 +1,110 @@
+/*
+ * main.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "image_diskio.h"
+#include "dir.h"
+#include "library.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+typedef struct {
+	size_t dirs;
+	size_t entries;
+} builder_stats_t;
+
+/* Walks the tree the same way the player does, which builds sorted index of each directory */
+static int index_tree(builder_stats_t *stats) {
+	dir_list_t *list = dir_list();
+	if (list == NULL) {
+		fprintf(stderr, "Failed to list '%s'\n", dir_get_fs_path());
+		return -EIO;
+	}
+
+	const size_t size = dir_list_size(list);
+	stats->dirs++;
+	stats->entries += size;
+
+	int ret = 0;
+	for (dir_entry_t entry = 0; (entry < size) && (ret == 0); ++entry) {
+		const dir_info_t *info = dir_get_info(list, entry);
+		if (info == NULL) {
+			ret = -EIO;
+			break;
+		}
+
+		if (!(info->attrib & AM_DIR)) {
+			continue;
+		}
+
+		/* Name has to be copied, list pages get replaced while walking the subtree */
+		char name[_MAX_LFN + 1];
+		strcpy(name, info->name);
+
+		if (dir_enter(name) != 0) {
+			fprintf(stderr, "Path too long, skipping '%s/%s'\n", dir_get_fs_path(), name);
+			continue;
+		}
+		ret = index_tree(stats);
+		dir_return();
+	}
+
+	dir_list_free(list);
+	return ret;
+}
+
+int main(int argc, char **argv) {
+	FATFS fatfs;
+	builder_stats_t stats = {0};
+	const char *const mount_point = "";
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <SD card image or block device>\n", argv[0]);
+		return 1;
+	}
+
+	if (image_diskio_open(argv[1]) != 0) {
+		fprintf(stderr, "Failed to open '%s'\n", argv[1]);
+		return 1;
+	}
+
+	if (f_mount(&fatfs, mount_point, 1) != FR_OK) {
+		fprintf(stderr, "Failed to mount '%s'\n", argv[1]);
+		image_diskio_close();
+		return 1;
+	}
+
+	/* Same modules as the firmware, so the result is exactly what the device would build itself */
+	dir_init(mount_point);
+	if (dir_cache_get_generation() == 0) {
+		fprintf(stderr, "Failed to create cache directory\n");
+		f_mount(NULL, mount_point, 0);
+		image_diskio_close();
+		return 1;
+	}
+
+	int ret = index_tree(&stats);
+	printf("Indexed %zu directories, %zu entries\n", stats.dirs, stats.entries);
+
+	library_init(mount_point);
+	while (library_get_state() == LIBRARY_SCANNING) {
+		library_task();
+	}
+
+	if (library_get_state() == LIBRARY_READY) {
+		printf("Library: %zu tracks\n", library_get_track_count());
+	}
+	else {
+		fprintf(stderr, "Failed to build library database\n");
+		ret = -EIO;
+	}
+
+	library_deinit();
+	f_mount(NULL, mount_point, 0);
+	image_diskio_close();
+
+	return (ret == 0) ? 0 : 1;
+}
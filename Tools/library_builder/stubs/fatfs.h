@@ -0,0 +1,2 @@
+/* Host build - FatFs without the generic driver layer of the target */
+#include "ff.h"
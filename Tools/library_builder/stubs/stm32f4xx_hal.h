@@ -0,0 +1 @@
+/* Host build - FatFs configuration of the target includes it, nothing is needed from it */
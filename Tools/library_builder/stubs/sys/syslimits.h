@@ -0,0 +1,2 @@
+/* Host build - newlib header providing PATH_MAX, same value as on the target */
+#define PATH_MAX 1024
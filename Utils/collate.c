@@ -0,0 +1,164 @@
+/*
+ * collate.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "collate.h"
+#include <string.h>
+
+#define COLLATE_CLASS_DIRECTORY 0x01
+#define COLLATE_CLASS_FILE 0x02
+
+/* Digits run is replaced with marker, number of significant digits and the digits themselves,
+ * so longer numbers sort after shorter ones. Marker has the weight of a digit. */
+#define COLLATE_NUMBER_MARKER '0'
+
+/* Base letter of each character in the upper half of CP850, 0 if it's not a letter */
+static const char cp850_fold[128] = {
+	'c', 'u', 'e', 'a', 'a', 'a', 'a', 'c', 'e', 'e', 'e', 'i', 'i', 'i', 'a', 'a', // 0x80
+	'e', 'a', 'a', 'o', 'o', 'o', 'u', 'u', 'y', 'o', 'u', 'o',  0,  'o',  0,  'f', // 0x90
+	'a', 'i', 'o', 'u', 'n', 'n',  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  // 0xA0
+	 0,   0,   0,   0,   0,  'a', 'a', 'a',  0,   0,   0,   0,   0,   0,   0,   0,  // 0xB0
+	 0,   0,   0,   0,   0,   0,  'a', 'a',  0,   0,   0,   0,   0,   0,   0,   0,  // 0xC0
+	'd', 'd', 'e', 'e', 'e', 'i', 'i', 'i', 'i',  0,   0,   0,   0,   0,  'i',  0,  // 0xD0
+	'o', 's', 'o', 'o', 'o', 'o',  0,   0,   0,  'u', 'u', 'u', 'y', 'y',  0,   0,  // 0xE0
+	 0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0   // 0xF0
+};
+
+static bool is_digit(uint8_t c) {
+	return (c >= '0') && (c <= '9');
+}
+
+static uint8_t fold(uint8_t c) {
+	if ((c >= 'A') && (c <= 'Z')) {
+		return c - 'A' + 'a';
+	}
+	if ((c >= 0x80) && (cp850_fold[c - 0x80] != 0)) {
+		return cp850_fold[c - 0x80];
+	}
+	return c;
+}
+
+static bool append(collate_key_t *key, uint8_t c) {
+	if (key->length == sizeof(key->data)) {
+		return false;
+	}
+	key->data[key->length++] = c;
+	return true;
+}
+
+void collate_make_key(collate_key_t *key, const char *name, bool is_directory) {
+	const uint8_t *src = (const uint8_t *)name;
+
+	key->length = 0;
+
+#if COLLATE_DIRECTORIES_FIRST
+	append(key, is_directory ? COLLATE_CLASS_DIRECTORY : COLLATE_CLASS_FILE);
+#endif
+
+	while (*src != '\0') {
+		if (!is_digit(*src)) {
+			if (!append(key, fold(*src))) {
+				return;
+			}
+			src++;
+			continue;
+		}
+
+		/* Skip leading zeros, they don't change the value */
+		while (*src == '0') {
+			src++;
+		}
+
+		size_t digits = 0;
+		while (is_digit(src[digits])) {
+			digits++;
+		}
+
+		if (!append(key, COLLATE_NUMBER_MARKER) || !append(key, digits)) {
+			return;
+		}
+		for (size_t i = 0; i < digits; ++i) {
+			if (!append(key, src[i])) {
+				return;
+			}
+		}
+		src += digits;
+	}
+}
+
+int collate_compare(const collate_key_t *key1, const collate_key_t *key2) {
+	const size_t length = (key1->length < key2->length) ? key1->length : key2->length;
+
+	const int ret = memcmp(key1->data, key2->data, length);
+	if (ret != 0) {
+		return ret;
+	}
+
+	/* Key being a prefix of the other sorts first */
+	return (int)key1->length - (int)key2->length;
+}
+
+void collate_make_prefix(collate_prefix_t *prefix, const char *name, bool is_directory) {
+	collate_make_key(&prefix->key, name, is_directory);
+	prefix->number_offset = COLLATE_NO_NUMBER;
+	prefix->number_digits = 0;
+
+	const size_t name_length = strlen(name);
+	if ((name_length == 0) || !is_digit(name[name_length - 1])) {
+		return;
+	}
+
+	/* Trailing number is the last one in the key - marker, length and digits - unless it was truncated */
+	size_t digits = 0;
+	while ((digits < name_length) && is_digit(name[name_length - 1 - digits])) {
+		digits++;
+	}
+	for (size_t i = name_length - digits; (i < name_length) && (name[i] == '0'); ++i) {
+		digits--;
+	}
+
+	if (prefix->key.length < (digits + 2)) {
+		return;
+	}
+
+	const size_t offset = prefix->key.length - digits - 2;
+	if ((prefix->key.data[offset] == COLLATE_NUMBER_MARKER) && (prefix->key.data[offset + 1] == digits)) {
+		prefix->number_offset = offset;
+		prefix->number_digits = digits;
+	}
+}
+
+bool collate_set_number_length(collate_prefix_t *prefix, size_t length) {
+	if ((prefix->number_offset == COLLATE_NO_NUMBER) || (length < prefix->number_digits) || (length > UINT8_MAX)) {
+		return false;
+	}
+
+	prefix->key.data[prefix->number_offset + 1] = length;
+	return true;
+}
+
+size_t collate_get_number_length(const collate_key_t *key, const collate_prefix_t *prefix) {
+	if ((prefix->number_offset == COLLATE_NO_NUMBER) || (key->length < (prefix->number_offset + 2))) {
+		return 0;
+	}
+
+	/* Everything up to and including number marker has to be the same */
+	if (memcmp(key->data, prefix->key.data, prefix->number_offset + 1) != 0) {
+		return 0;
+	}
+	return key->data[prefix->number_offset + 1];
+}
+
+bool collate_has_prefix(const collate_key_t *key, const collate_prefix_t *prefix) {
+	if (prefix->number_offset == COLLATE_NO_NUMBER) {
+		return (key->length >= prefix->key.length) && (memcmp(key->data, prefix->key.data, prefix->key.length) == 0);
+	}
+
+	/* Number may be longer than trailing number of the prefix, as long as it starts with its digits */
+	const size_t digits_offset = prefix->number_offset + 2;
+	return (collate_get_number_length(key, prefix) >= prefix->number_digits) &&
+		   (key->length >= (digits_offset + prefix->number_digits)) &&
+		   (memcmp(&key->data[digits_offset], &prefix->key.data[digits_offset], prefix->number_digits) == 0);
+}
@@ -0,0 +1,56 @@
+/*
+ * collate.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+
+#ifndef COLLATE_H_
+#define COLLATE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Put directories before files in listings */
+#define COLLATE_DIRECTORIES_FIRST 1
+
+/* Longer keys are truncated, names equal up to that point keep their order */
+#define COLLATE_KEY_LENGTH 96
+
+/* Sort key of a CP850 name - case and accents folded, runs of digits compared by value.
+ * Comparing keys with memcmp gives natural order, e.g. "track 2" < "Track 10". */
+typedef struct {
+	uint8_t length;
+	uint8_t data[COLLATE_KEY_LENGTH];
+} collate_key_t;
+
+/* Key of the beginning of a name. Number it ends with may be the beginning of a longer one, e.g. "1" of "10",
+ * so it matches any number starting with its digits. Numbers of different lengths don't sort next to each
+ * other - "2" sorts between "1" and "10" - so they are searched for one length at a time. */
+typedef struct {
+	collate_key_t key;
+	size_t number_offset; // Offset of trailing number in the key, COLLATE_NO_NUMBER if name doesn't end with digit
+	uint8_t number_digits; // Significant digits of trailing number
+} collate_prefix_t;
+
+#define COLLATE_NO_NUMBER SIZE_MAX
+
+void collate_make_key(collate_key_t *key, const char *name, bool is_directory);
+
+/* Returns negative value, 0 or positive value if key1 sorts before, same as or after key2 */
+int collate_compare(const collate_key_t *key1, const collate_key_t *key2);
+
+/* Makes prefix key, trailing number of which is searched among numbers as long as its significant digits */
+void collate_make_prefix(collate_prefix_t *prefix, const char *name, bool is_directory);
+
+/* Makes prefix key search among numbers of given length, returns false if it can't be that long */
+bool collate_set_number_length(collate_prefix_t *prefix, size_t length);
+
+/* Returns length of number key has in place of trailing number of prefix, 0 if it differs before it */
+size_t collate_get_number_length(const collate_key_t *key, const collate_prefix_t *prefix);
+
+/* Checks whether name the key was made of starts with the name the prefix was made of */
+bool collate_has_prefix(const collate_key_t *key, const collate_prefix_t *prefix);
+
+#endif /* COLLATE_H_ */
@@ -5,13 +5,25 @@
  *      Author: lefucjusz
  */
 #include "dir.h"
+#include "dir_cache.h"
+#include "collate.h"
 #include <sys/syslimits.h>
+#include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <errno.h>
 
 static char path[PATH_MAX];
 static size_t depth;
+static size_t root_length;
+static dir_list_t *retained[DIR_RETAIN_SLOTS]; // Oldest first
+
+/* Listing of directory the cursor rests on, built in steps while the user decides whether to enter it */
+static struct {
+	dir_list_t *list; // NULL if no prefetch is in progress
+	dir_cache_builder_t *builder;
+} prefetch;
 
 static int path_append(const char *name) {
 	const size_t cur_path_len = strlen(path);
@@ -36,16 +48,292 @@ static int path_remove(void) {
 	return 0;
 }
 
-static bool compare_ascending(const void *val1, const void *val2) {
-	const FILINFO *fno1 = (FILINFO *)val1;
-	const FILINFO *fno2 = (FILINFO *)val2;
+/* Names buffer size of a single page when listing is read without index, fits the longest names */
+#define DIR_UNINDEXED_PAGE_SIZE (DIR_CACHE_PAGE_ENTRIES * (_MAX_LFN + 1))
+
+typedef struct {
+	size_t page; // Index of the page, DIR_ENTRY_INVALID if slot is unused
+	size_t count; // Number of entries in the page
+	uint32_t last_use; // Value of use counter when page was last accessed
+	dir_info_t entries[DIR_CACHE_PAGE_ENTRIES];
+	char *names; // Packed names of the entries, part of list names pool
+} dir_page_t;
+
+struct dir_list_t {
+	char *path; // Directory the listing was made of
+	bool is_root;
+	size_t memory; // Bytes allocated for the listing, counted against DIR_RETAIN_MEMORY_LIMIT
+	bool prefetched; // Retained ahead of entering, not used yet
+	dir_cache_t index;
+	DIR dir; // Read directly, in directory order, if index couldn't be built
+	bool indexed;
+	size_t size;
+	uint32_t use_counter;
+	dir_page_t pages[DIR_PAGE_CACHE_SIZE]; // Recently used pages, evicted in LRU order
+	char *names_pool; // Single allocation split evenly between pages
+};
+
+static bool is_cache_dir(const dir_list_t *list, const FILINFO *fno) {
+	return list->is_root && (strcmp(fno->fname, DIR_CACHE_DIR_NAME) == 0);
+}
+
+/* Known right after opening, no entry has to be read */
+static void get_stamp(const dir_list_t *list, dir_cache_stamp_t *stamp) {
+	stamp->cluster = list->dir.obj.sclust;
+}
+
+static int read_next(dir_list_t *list, FILINFO *fno) {
+	while (1) {
+		const FRESULT ret = f_readdir(&list->dir, fno);
+		if (ret != FR_OK) {
+			return -EIO;
+		}
+		if (fno->fname[0] == '\0') {
+			return -ENOENT;
+		}
+		if (!is_cache_dir(list, fno)) {
+			return 0;
+		}
+	}
+}
+
+/* Fallback when index is unavailable - no random access to directory, so skip all the preceding entries */
+static int read_page_unindexed(dir_list_t *list, size_t page, dir_info_t *entries, char *names) {
+	FILINFO fno;
+	size_t count = 0;
+	size_t names_length = 0;
+	size_t to_skip = page * DIR_CACHE_PAGE_ENTRIES;
+
+	if (f_rewinddir(&list->dir) != FR_OK) {
+		return -EIO;
+	}
+
+	while (count < DIR_CACHE_PAGE_ENTRIES) {
+		const int ret = read_next(list, &fno);
+		if (ret == -ENOENT) {
+			break;
+		}
+		if (ret != 0) {
+			return ret;
+		}
+
+		if (to_skip > 0) {
+			to_skip--;
+			continue;
+		}
+
+		const size_t name_length = strlen(fno.fname) + 1;
+		memcpy(&names[names_length], fno.fname, name_length);
+		entries[count].name = &names[names_length];
+		entries[count].size = fno.fsize;
+		entries[count].attrib = fno.fattrib;
+
+		names_length += name_length;
+		count++;
+	}
+
+	return count;
+}
+
+static size_t count_entries(dir_list_t *list) {
+	FILINFO fno;
+	size_t count = 0;
+
+	while (read_next(list, &fno) == 0) {
+		count++;
+	}
+	return count;
+}
+
+static dir_page_t *get_page(dir_list_t *list, size_t page) {
+	dir_page_t *victim = &list->pages[0];
+
+	list->use_counter++;
+
+	/* Page already loaded */
+	for (size_t i = 0; i < DIR_PAGE_CACHE_SIZE; ++i) {
+		if (list->pages[i].page == page) {
+			list->pages[i].last_use = list->use_counter;
+			return &list->pages[i];
+		}
+		if (list->pages[i].last_use < victim->last_use) {
+			victim = &list->pages[i];
+		}
+	}
+
+	/* Replace least recently used one */
+	victim->page = DIR_ENTRY_INVALID;
+	const int ret = list->indexed ? dir_cache_read_page(&list->index, page, victim->entries, victim->names) : read_page_unindexed(list, page, victim->entries, victim->names);
+	if (ret <= 0) {
+		return NULL;
+	}
+
+	victim->page = page;
+	victim->count = ret;
+	victim->last_use = list->use_counter;
+	return victim;
+}
+
+static size_t get_retained_memory(void) {
+	size_t memory = 0;
+	for (size_t i = 0; i < DIR_RETAIN_SLOTS; ++i) {
+		if (retained[i] != NULL) {
+			memory += retained[i]->memory;
+		}
+	}
+	return memory;
+}
+
+static dir_list_t *remove_retained(size_t slot) {
+	dir_list_t *list = retained[slot];
+
+	/* Keep the order, oldest first */
+	for (size_t i = slot; i < (DIR_RETAIN_SLOTS - 1); ++i) {
+		retained[i] = retained[i + 1];
+	}
+	retained[DIR_RETAIN_SLOTS - 1] = NULL;
+
+	return list;
+}
+
+static dir_list_t *take_retained(const char *list_path) {
+	for (size_t i = 0; i < DIR_RETAIN_SLOTS; ++i) {
+		if ((retained[i] != NULL) && (strcmp(retained[i]->path, list_path) == 0)) {
+			dir_list_t *list = remove_retained(i);
+			list->prefetched = false;
+			return list;
+		}
+	}
+	return NULL;
+}
+
+static void retain(dir_list_t *list, bool prefetched) {
+	/* Too big to be kept at all */
+	if (list->memory > DIR_RETAIN_MEMORY_LIMIT) {
+		dir_list_free(list);
+		return;
+	}
+
+	/* Make room, evicting the oldest ones */
+	while ((retained[DIR_RETAIN_SLOTS - 1] != NULL) || ((get_retained_memory() + list->memory) > DIR_RETAIN_MEMORY_LIMIT)) {
+		dir_list_free(remove_retained(0));
+	}
+
+	for (size_t i = 0; i < DIR_RETAIN_SLOTS; ++i) {
+		if (retained[i] == NULL) {
+			list->prefetched = prefetched;
+			retained[i] = list;
+			break;
+		}
+	}
+}
+
+/* Opens the directory, listing has no entries until index is opened or entries are counted */
+static dir_list_t *open_list(const char *list_path) {
+	dir_list_t *list = calloc(1, sizeof(dir_list_t));
+	if (list == NULL) {
+		return NULL;
+	}
+
+	for (size_t i = 0; i < DIR_PAGE_CACHE_SIZE; ++i) {
+		list->pages[i].page = DIR_ENTRY_INVALID;
+	}
+
+	list->path = strdup(list_path);
+	if (list->path == NULL) {
+		free(list);
+		return NULL;
+	}
+	list->is_root = (strlen(list_path) <= root_length);
+
+	if (f_opendir(&list->dir, list_path) != FR_OK) {
+		free(list->path);
+		free(list);
+		return NULL;
+	}
+
+	return list;
+}
+
+/* Use sorted index if directory hasn't changed */
+static int open_index(dir_list_t *list) {
+	dir_cache_stamp_t stamp;
+
+	get_stamp(list, &stamp);
+	const int ret = dir_cache_open(&list->index, list->path, &stamp);
+	if (ret != 0) {
+		return ret;
+	}
+
+	f_closedir(&list->dir);
+	list->indexed = true;
+	list->size = list->index.count;
+	return 0;
+}
+
+static int build_index(dir_list_t *list) {
+	dir_cache_stamp_t stamp;
+
+	get_stamp(list, &stamp);
+	const int ret = dir_cache_build(&list->dir, list->path, &stamp);
+	return (ret == 0) ? open_index(list) : ret;
+}
+
+/* Allocates names pool once the size of pages is known, frees the listing on failure */
+static dir_list_t *complete_list(dir_list_t *list) {
+	const size_t page_size = list->indexed ? list->index.max_page_size : DIR_UNINDEXED_PAGE_SIZE;
+
+	/* All the names live in one pool instead of an allocation per entry */
+	list->names_pool = malloc(DIR_PAGE_CACHE_SIZE * page_size);
+	if ((list->names_pool == NULL) && (page_size > 0)) {
+		dir_list_free(list);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < DIR_PAGE_CACHE_SIZE; ++i) {
+		list->pages[i].names = &list->names_pool[i * page_size];
+	}
+
+	list->memory = sizeof(dir_list_t) + strlen(list->path) + 1 + (DIR_PAGE_CACHE_SIZE * page_size);
+	if (list->indexed) {
+		list->memory += ((list->size + DIR_CACHE_PAGE_ENTRIES - 1) / DIR_CACHE_PAGE_ENTRIES) * sizeof(uint32_t); // Page table
+	}
+
+	return list;
+}
+
+static dir_list_t *create_list(const char *list_path) {
+	dir_list_t *list = open_list(list_path);
+	if (list == NULL) {
+		return NULL;
+	}
 
-	return (strcmp(fno1->fname, fno2->fname) > 0);
+	if ((open_index(list) != 0) && (build_index(list) != 0)) {
+		/* No index - list entries unsorted, straight from the directory */
+		f_rewinddir(&list->dir);
+		list->size = count_entries(list);
+	}
+
+	return complete_list(list);
+}
+
+static void cancel_prefetch(void) {
+	if (prefetch.list == NULL) {
+		return;
+	}
+
+	dir_cache_build_abort(prefetch.builder);
+	dir_list_free(prefetch.list);
+	memset(&prefetch, 0, sizeof(prefetch));
 }
 
 void dir_init(const char *root_path) {
 	strncpy(path, root_path, sizeof(path));
 	depth = 0;
+	root_length = strlen(path);
+
+	/* Listings will just not be cached if it fails */
+	dir_cache_init(root_path);
 }
 
 int dir_enter(const char *name) {
@@ -73,72 +361,266 @@ const char *dir_get_fs_path(void) {
 }
 
 dir_list_t *dir_list(void) {
-	DIR dir;
-	FILINFO fno;
-	FRESULT ret;
-	dir_list_t *list = list_create();
+	return dir_list_path(path);
+}
 
-	ret = f_opendir(&dir, path);
-	if (ret != FR_OK) {
+dir_list_t *dir_list_path(const char *list_path) {
+	/* Sanity check */
+	if (list_path == NULL) {
 		return NULL;
 	}
 
-	while (1) {
-		ret = f_readdir(&dir, &fno);
-		if ((ret != FR_OK) || (fno.fname[0] == '\0')) {
-			break;
-		}
+	/* Needed right now - finish it. Any other one is dropped, it would share temporary files with this build. */
+	if ((prefetch.list != NULL) && (strcmp(prefetch.list->path, list_path) == 0)) {
+		while (dir_prefetch_step() > 0);
+	}
+	cancel_prefetch();
 
-		list_add(list, &fno, sizeof(FILINFO), LIST_PREPEND);
+	/* Listing kept from previous visit or prefetched */
+	dir_list_t *list = take_retained(list_path);
+	if (list != NULL) {
+		return list;
 	}
 
-	/* Sort alphabetically ascending */
-	list_sort(list, compare_ascending);
+	return create_list(list_path);
+}
 
-	f_closedir(&dir);
-	return list;
+void dir_list_retain(dir_list_t *list) {
+	if (list == NULL) {
+		return;
+	}
+
+	retain(list, false);
 }
 
-dir_entry_t *dir_get_prev(dir_list_t *list, dir_entry_t *current) {
-	if ((list == NULL) || (current == NULL)) {
-		return NULL;
+int dir_prefetch(const char *name) {
+	int ret;
+
+	/* Only the latest guess is worth finishing */
+	cancel_prefetch();
+
+	/* Listed under current path extended with the name, exactly as after dir_enter */
+	ret = dir_enter(name);
+	if (ret != 0) {
+		return ret;
 	}
 
-	dir_entry_t *entry = list->head;
-	do {
-		if (entry->data == current->data) {
-			break;
+	dir_list_t *list = take_retained(path);
+	if (list != NULL) {
+		retain(list, true);
+		dir_return();
+		return 0;
+	}
+
+	/* Only the latest guess is kept, so prefetching never pushes out listing of parent directory */
+	for (size_t i = DIR_RETAIN_SLOTS; i-- > 0;) {
+		if ((retained[i] != NULL) && retained[i]->prefetched) {
+			dir_list_free(remove_retained(i));
 		}
-		entry = entry->next;
+	}
 
-	} while (entry != NULL);
+	list = open_list(path);
+	dir_return();
+	if (list == NULL) {
+		return -EIO;
+	}
 
-	if ((entry == NULL) || (entry->prev == NULL)) {
-		return list->tail;
+	/* Valid index is opened at once, building one is left for dir_prefetch_step */
+	if (open_index(list) == 0) {
+		list = complete_list(list);
+		if (list == NULL) {
+			return -ENOMEM;
+		}
+		retain(list, true);
+		return 0;
+	}
+
+	dir_cache_stamp_t stamp;
+	get_stamp(list, &stamp);
+	ret = dir_cache_build_start(&prefetch.builder, &list->dir, list->path, &stamp);
+	if (ret != 0) {
+		dir_list_free(list);
+		return ret;
 	}
-	return entry->prev;
+
+	prefetch.list = list;
+	return 0;
+}
+
+int dir_prefetch_step(void) {
+	if (prefetch.list == NULL) {
+		return 0;
+	}
+
+	int ret = dir_cache_build_step(prefetch.builder);
+	if (ret > 0) {
+		return 1;
+	}
+
+	/* Builder is freed once it's done, either way */
+	dir_list_t *list = prefetch.list;
+	memset(&prefetch, 0, sizeof(prefetch));
+
+	/* Without index the directory would have to be read again to count entries, entering it will do that */
+	if ((ret != 0) || ((ret = open_index(list)) != 0)) {
+		dir_list_free(list);
+		return ret;
+	}
+
+	list = complete_list(list);
+	if (list == NULL) {
+		return -ENOMEM;
+	}
+
+	retain(list, true);
+	return 0;
+}
+
+size_t dir_list_size(const dir_list_t *list) {
+	return (list != NULL) ? list->size : 0;
 }
 
-dir_entry_t *dir_get_next(dir_list_t *list, dir_entry_t *current) {
-	if ((list == NULL) || (current == NULL)) {
+const dir_info_t *dir_get_info(dir_list_t *list, dir_entry_t entry) {
+	if ((list == NULL) || (entry >= list->size)) {
 		return NULL;
 	}
 
-	dir_entry_t *entry = list->head;
-	do {
-		if (entry->data == current->data) {
+	const dir_page_t *page = get_page(list, entry / DIR_CACHE_PAGE_ENTRIES);
+	if ((page == NULL) || ((entry % DIR_CACHE_PAGE_ENTRIES) >= page->count)) {
+		return NULL;
+	}
+
+	return &page->entries[entry % DIR_CACHE_PAGE_ENTRIES];
+}
+
+dir_entry_t dir_get_prev(const dir_list_t *list, dir_entry_t current) {
+	if ((list == NULL) || (list->size == 0) || (current >= list->size)) {
+		return DIR_ENTRY_INVALID;
+	}
+
+	return (current == 0) ? (list->size - 1) : (current - 1);
+}
+
+dir_entry_t dir_get_next(const dir_list_t *list, dir_entry_t current) {
+	if ((list == NULL) || (list->size == 0) || (current >= list->size)) {
+		return DIR_ENTRY_INVALID;
+	}
+
+	return ((current + 1) == list->size) ? 0 : (current + 1);
+}
+
+/* Returns first entry not sorting before the key, list size if there's no such */
+static dir_entry_t lower_bound(dir_list_t *list, const collate_key_t *key) {
+	collate_key_t entry_key;
+	size_t low = 0;
+	size_t high = list->size;
+
+	while (low < high) {
+		const size_t middle = low + (high - low) / 2;
+		const dir_info_t *info = dir_get_info(list, middle);
+		if (info == NULL) {
+			return DIR_ENTRY_INVALID;
+		}
+
+		collate_make_key(&entry_key, info->name, (info->attrib & AM_DIR) != 0);
+		if (collate_compare(&entry_key, key) < 0) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+static bool get_entry_key(dir_list_t *list, dir_entry_t entry, collate_key_t *key) {
+	const dir_info_t *info = dir_get_info(list, entry);
+	if (info == NULL) {
+		return false;
+	}
+
+	collate_make_key(key, info->name, (info->attrib & AM_DIR) != 0);
+	return true;
+}
+
+/* Finds the first entry of a class starting with prefix. If there's none, found is cleared and the entry
+ * the prefix would be inserted before is returned. */
+static dir_entry_t find_prefix(dir_list_t *list, const char *prefix_name, bool is_directory, bool *found) {
+	collate_prefix_t prefix;
+	collate_key_t entry_key;
+
+	collate_make_prefix(&prefix, prefix_name, is_directory);
+	const dir_entry_t closest = lower_bound(list, &prefix.key);
+	*found = false;
+
+	/* Try each length of trailing number, from the shortest one, skipping lengths there are no entries of */
+	size_t length = prefix.number_digits;
+	dir_entry_t entry = closest;
+	while ((entry != DIR_ENTRY_INVALID) && (entry < list->size)) {
+		if (!get_entry_key(list, entry, &entry_key)) {
+			return DIR_ENTRY_INVALID;
+		}
+
+		if (collate_has_prefix(&entry_key, &prefix)) {
+			*found = true;
+			return entry;
+		}
+
+		const size_t entry_length = collate_get_number_length(&entry_key, &prefix);
+		if (entry_length == 0) {
+			break; // Past all the numbers the prefix could match
+		}
+
+		length = (entry_length > length) ? entry_length : (length + 1);
+		if (!collate_set_number_length(&prefix, length)) {
 			break;
 		}
-		entry = entry->next;
+		entry = lower_bound(list, &prefix.key);
+	}
 
-	} while (entry != NULL);
+	return closest;
+}
+
+dir_entry_t dir_find(dir_list_t *list, const char *prefix) {
+	/* Sanity check */
+	if ((list == NULL) || (prefix == NULL)) {
+		return DIR_ENTRY_INVALID;
+	}
+
+	/* Only index is sorted */
+	if (!list->indexed || (list->size == 0)) {
+		return DIR_ENTRY_INVALID;
+	}
+
+	/* Directories and files are sorted as separate blocks, search the first one before falling back to the other */
+	bool found;
+	dir_entry_t entry = find_prefix(list, prefix, true, &found);
+	if ((entry == DIR_ENTRY_INVALID) || found) {
+		return entry;
+	}
 
-	if ((entry == NULL) || (entry->next == NULL)) {
-		return list->head;
+	entry = find_prefix(list, prefix, false, &found);
+	if (entry == DIR_ENTRY_INVALID) {
+		return entry;
 	}
-	return entry->next;
+
+	/* Nothing sorts after the prefix, closest one is the last entry */
+	return (entry < list->size) ? entry : (list->size - 1);
 }
 
 void dir_list_free(dir_list_t *list) {
-	list_destroy(list);
+	if (list == NULL) {
+		return;
+	}
+
+	if (list->indexed) {
+		dir_cache_close(&list->index);
+	}
+	else {
+		f_closedir(&list->dir);
+	}
+	free(list->names_pool);
+	free(list->path);
+	free(list);
 }
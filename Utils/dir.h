@@ -8,11 +8,29 @@
 #ifndef DIR_H_
 #define DIR_H_
 
-#include "list.h"
 #include "fatfs.h"
+#include "dir_cache.h"
+#include <stddef.h>
+#include <stdint.h>
 
-typedef struct list_t dir_list_t;
-typedef struct list_node_t dir_entry_t;
+/* Number of pages of entries kept in RAM by a single listing */
+#define DIR_PAGE_CACHE_SIZE 4
+
+/* Listings kept in RAM for quick return to them or prefetched ahead of entering */
+#define DIR_RETAIN_SLOTS 2
+#define DIR_RETAIN_MEMORY_LIMIT 8192 // Bytes, for all retained listings in total
+
+#define DIR_ENTRY_INVALID SIZE_MAX
+
+/* Listing is paged - only entry count and a few recently used pages of names are kept in RAM,
+ * the rest is loaded on demand from directory index on the card */
+typedef struct dir_list_t dir_list_t;
+
+/* Cursor - position of entry in sorted listing */
+typedef size_t dir_entry_t;
+
+/* Name, size and attributes of an entry */
+typedef dir_cache_entry_t dir_info_t;
 
 void dir_init(const char *root_path);
 
@@ -21,13 +39,39 @@ int dir_return(void);
 
 const char *dir_get_fs_path(void);
 
+/* Lists current directory, takes retained listing if there is one */
 dir_list_t *dir_list(void);
 
+/* Lists directory with given path, independent of current directory */
+dir_list_t *dir_list_path(const char *list_path);
+
+/* Keeps the listing instead of freeing it, evicting the oldest retained ones to stay under the limits */
+void dir_list_retain(dir_list_t *list);
+
+/* Starts listing subdirectory of current directory, the listing is retained once done, so entering it is instant.
+ * Valid index is opened right away, otherwise it's built by dir_prefetch_step. Replaces prefetch in progress. */
+int dir_prefetch(const char *name);
+
+/* Does a bounded part of the prefetch in progress - reads, sorts or merges up to a run of entries.
+ * Returns 1 if there's more to do, 0 when done or there's nothing to prefetch, negative error code on failure. */
+int dir_prefetch_step(void);
+
+/* Returns number of entries, 0 for empty or NULL list */
+size_t dir_list_size(const dir_list_t *list);
+
+/* Returns entry info or NULL on failure. Info and its name stay valid until entries
+ * from DIR_PAGE_CACHE_SIZE other pages are requested. */
+const dir_info_t *dir_get_info(dir_list_t *list, dir_entry_t entry);
+
 /* Returns previous element, if there's no such, returns last (looped list) */
-dir_entry_t *dir_get_prev(dir_list_t *list, dir_entry_t *current);
+dir_entry_t dir_get_prev(const dir_list_t *list, dir_entry_t current);
 
 /* Returns next element, if there's no such, returns first (looped list) */
-dir_entry_t *dir_get_next(dir_list_t *list, dir_entry_t *current);
+dir_entry_t dir_get_next(const dir_list_t *list, dir_entry_t current);
+
+/* Returns first entry in sort order that is not before the prefix, preferring one starting with it.
+ * Binary search over the index, unsorted (not indexed) listings return DIR_ENTRY_INVALID. */
+dir_entry_t dir_find(dir_list_t *list, const char *prefix);
 
 void dir_list_free(dir_list_t *list);
 
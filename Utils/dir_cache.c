@@ -0,0 +1,1007 @@
+/*
+ * dir_cache.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "dir_cache.h"
+#include "list.h"
+#include "collate.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+#define DIR_CACHE_MAGIC 0x58444944 // "DIDX"
+#define DIR_CACHE_STATE_MAGIC 0x54534344 // "DCST"
+#define DIR_CACHE_VERSION 5
+
+#define DIR_CACHE_STATE_FILE "state"
+#define DIR_CACHE_FILE_EXT "idx"
+#define DIR_CACHE_FILE_NAME_LENGTH 12 // 8 hex digits, dot, extension
+
+#define DIR_CACHE_COMPARE_CHUNK 32 // Bytes of path compared at once
+
+/* Index build parameters */
+#define DIR_CACHE_RUN_FILE "run%u.tmp"
+#define DIR_CACHE_RUN_ENTRIES 32 // Entries sorted in RAM at once
+#define DIR_CACHE_MERGE_WAYS 4 // Runs merged at once
+#define DIR_CACHE_READER_BUFFER_SIZE 512 // Read buffer of each merged run
+
+/* Header flags - index sorted with different options is stale */
+#define DIR_CACHE_FLAG_DIRECTORIES_FIRST 0x0001
+#define DIR_CACHE_FLAGS (COLLATE_DIRECTORIES_FIRST ? DIR_CACHE_FLAG_DIRECTORIES_FIRST : 0)
+
+#define DIV_ROUND_UP(x, y) (((x) + (y) - 1) / (y))
+
+/* Index file layout: header, directory path (without null-terminator), records sorted
+ * the same way as listing, table of offsets of the first record of each page */
+typedef struct __attribute__((packed)) {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t path_length;
+	uint16_t page_entries;
+	uint16_t flags;
+	uint32_t generation;
+	uint32_t cluster;
+	uint32_t count;
+	uint32_t pages_offset;
+} dir_cache_header_t;
+
+/* Record is followed by name_length bytes of entry name, without null-terminator */
+typedef struct __attribute__((packed)) {
+	uint8_t attrib;
+	uint8_t name_length;
+	uint32_t size;
+} dir_cache_record_t;
+
+/* State file keeps free clusters count seen after the last write done by the device.
+ * If it differs at startup, the card has been modified elsewhere and generation is
+ * bumped, which invalidates all the index files at once. */
+typedef struct __attribute__((packed)) {
+	uint32_t magic;
+	uint32_t generation;
+	uint32_t free_clusters;
+} dir_cache_state_t;
+
+typedef struct {
+	char root_path[DIR_CACHE_PATH_LENGTH];
+	uint32_t generation;
+	uint32_t free_clusters; // Stored in state file
+	bool enabled;
+} dir_cache_ctx_t;
+
+/* Entry being sorted, along with its sort key */
+typedef struct {
+	FILINFO fno;
+	collate_key_t key;
+} dir_cache_item_t;
+
+/* Sorted run being merged */
+typedef struct {
+	FSIZE_t offset; // Next offset to be fetched
+	FSIZE_t end; // End of the run
+	size_t pos;
+	size_t fill;
+	uint8_t buffer[DIR_CACHE_READER_BUFFER_SIZE];
+	dir_cache_item_t head; // Smallest record of the run not merged yet
+	bool valid; // False if run is exhausted
+	bool error;
+} dir_cache_reader_t;
+
+/* Boundaries of sorted runs in temporary file, bounds[i] is start of i-th run, bounds[i + 1] its end */
+typedef struct {
+	FSIZE_t *bounds;
+	size_t count; // Number of bounds, one more than number of runs
+	size_t capacity;
+} dir_cache_runs_t;
+
+/* Writes records of final index and collects page offsets */
+typedef struct {
+	FIL *file;
+	uint32_t count;
+	uint32_t *page_offsets;
+	size_t page_capacity;
+} dir_cache_writer_t;
+
+typedef FRESULT (*dir_cache_emit_t)(void *user_data, const FILINFO *fno);
+
+typedef struct {
+	dir_cache_emit_t emit;
+	void *user_data;
+	FRESULT ret;
+} dir_cache_emitter_t;
+
+typedef enum {
+	BUILD_SCAN, // Reading directory into sorted runs
+	BUILD_REDUCE, // Merging groups of runs until few enough are left
+	BUILD_INDEX, // Merging the rest into the index
+	BUILD_FINISH,
+	BUILD_DONE
+} dir_cache_build_t;
+
+/* Index build context, allocated only for the time of building. Kept between
+ * steps, each of them reads, sorts or merges up to DIR_CACHE_RUN_ENTRIES entries. */
+struct dir_cache_builder_t {
+	dir_cache_build_t step;
+	DIR *dir;
+	char *path;
+	char index_path[DIR_CACHE_PATH_LENGTH];
+	struct list_t *list; // Entries of the run being read
+	size_t entries;
+	FIL run_files[2];
+	bool run_file_open[2];
+	size_t src; // Run file holding the runs
+	dir_cache_runs_t runs;
+	dir_cache_runs_t merged; // Runs written by the pass being done, empty between passes
+	size_t next_run; // First run of the group merged next
+	size_t ways; // Runs merged by the merge being done, 0 if none
+	FIL index_file;
+	bool index_file_open;
+	dir_cache_header_t header;
+	dir_cache_writer_t writer;
+	dir_cache_reader_t readers[DIR_CACHE_MERGE_WAYS];
+};
+
+static dir_cache_ctx_t ctx;
+
+static uint32_t hash_path(const char *path) {
+	/* 32-bit FNV-1a */
+	uint32_t hash = 2166136261UL;
+	while (*path != '\0') {
+		hash ^= (uint8_t)*path++;
+		hash *= 16777619UL;
+	}
+	return hash;
+}
+
+static int get_cache_path(char *buffer, size_t size, const char *file_name) {
+	const int length = snprintf(buffer, size, "%s/%s/%s", ctx.root_path, DIR_CACHE_DIR_NAME, file_name);
+	return ((length < 0) || ((size_t)length >= size)) ? -ENAMETOOLONG : 0;
+}
+
+static int get_index_path(char *buffer, size_t size, const char *path) {
+	char file_name[DIR_CACHE_FILE_NAME_LENGTH + 1];
+	snprintf(file_name, sizeof(file_name), "%08lX.%s", (unsigned long)hash_path(path), DIR_CACHE_FILE_EXT);
+	return get_cache_path(buffer, size, file_name);
+}
+
+static int update_state(void) {
+	FIL file;
+	UINT bytes_written;
+	DWORD free_clusters;
+	FATFS *fs;
+	char state_path[DIR_CACHE_PATH_LENGTH];
+
+	if (get_cache_path(state_path, sizeof(state_path), DIR_CACHE_STATE_FILE) != 0) {
+		return -ENAMETOOLONG;
+	}
+
+	dir_cache_state_t state = {
+		.magic = DIR_CACHE_STATE_MAGIC,
+		.generation = ctx.generation,
+		.free_clusters = 0
+	};
+
+	if (f_open(&file, state_path, FA_OPEN_ALWAYS | FA_WRITE) != FR_OK) {
+		return -EIO;
+	}
+
+	/* State file has to be allocated before free space is measured, rewriting it later won't change it */
+	FRESULT ret = f_write(&file, &state, sizeof(state), &bytes_written);
+	if (ret == FR_OK) {
+		ret = f_getfree(ctx.root_path, &free_clusters, &fs);
+	}
+	if (ret == FR_OK) {
+		state.free_clusters = free_clusters;
+		ret = f_lseek(&file, 0);
+	}
+	if (ret == FR_OK) {
+		ret = f_write(&file, &state, sizeof(state), &bytes_written);
+	}
+
+	/* Closing the file flushes it */
+	if ((f_close(&file) != FR_OK) || (ret != FR_OK)) {
+		return -EIO;
+	}
+
+	ctx.free_clusters = state.free_clusters;
+	return 0;
+}
+
+static bool read_state(dir_cache_state_t *state) {
+	FIL file;
+	UINT bytes_read;
+	char state_path[DIR_CACHE_PATH_LENGTH];
+
+	if (get_cache_path(state_path, sizeof(state_path), DIR_CACHE_STATE_FILE) != 0) {
+		return false;
+	}
+
+	if (f_open(&file, state_path, FA_READ) != FR_OK) {
+		return false;
+	}
+
+	const FRESULT ret = f_read(&file, state, sizeof(dir_cache_state_t), &bytes_read);
+	f_close(&file);
+
+	return (ret == FR_OK) && (bytes_read == sizeof(dir_cache_state_t)) && (state->magic == DIR_CACHE_STATE_MAGIC);
+}
+
+static bool compare_ascending(const void *val1, const void *val2) {
+	const dir_cache_item_t *item1 = (dir_cache_item_t *)val1;
+	const dir_cache_item_t *item2 = (dir_cache_item_t *)val2;
+
+	/* Raw names only break ties, keeps the order independent of directory order */
+	int ret = collate_compare(&item1->key, &item2->key);
+	if (ret == 0) {
+		ret = strcmp(item1->fno.fname, item2->fno.fname);
+	}
+	return (ret > 0);
+}
+
+static void make_item(dir_cache_item_t *item) {
+	collate_make_key(&item->key, item->fno.fname, item->fno.fattrib & AM_DIR);
+}
+
+static bool is_cache_dir(const char *path, const FILINFO *fno) {
+	return (strcmp(path, ctx.root_path) == 0) && (strcmp(fno->fname, DIR_CACHE_DIR_NAME) == 0);
+}
+
+/* Record encoding */
+static FRESULT write_record(FIL *file, const FILINFO *fno) {
+	UINT bytes_written;
+
+	const dir_cache_record_t record = {
+		.attrib = fno->fattrib,
+		.name_length = strlen(fno->fname),
+		.size = fno->fsize
+	};
+
+	FRESULT ret = f_write(file, &record, sizeof(record), &bytes_written);
+	if (ret == FR_OK) {
+		ret = f_write(file, fno->fname, record.name_length, &bytes_written);
+	}
+	return ret;
+}
+
+static uint32_t get_page_size(const dir_cache_t *cache, size_t page) {
+	const size_t last_page = (cache->count - 1) / DIR_CACHE_PAGE_ENTRIES;
+	const uint32_t page_end = (page == last_page) ? cache->records_end : cache->page_offsets[page + 1];
+	return page_end - cache->page_offsets[page];
+}
+
+static bool read_header(FIL *file, const char *path, const dir_cache_stamp_t *stamp, dir_cache_header_t *header) {
+	UINT bytes_read;
+
+	if ((f_read(file, header, sizeof(dir_cache_header_t), &bytes_read) != FR_OK) || (bytes_read != sizeof(dir_cache_header_t))) {
+		return false;
+	}
+
+	const size_t path_length = strlen(path);
+	if ((header->magic != DIR_CACHE_MAGIC) ||
+		(header->version != DIR_CACHE_VERSION) ||
+		(header->page_entries != DIR_CACHE_PAGE_ENTRIES) ||
+		(header->flags != DIR_CACHE_FLAGS) ||
+		(header->generation != ctx.generation) ||
+		(header->cluster != stamp->cluster) ||
+		(header->path_length != path_length)) {
+		return false;
+	}
+
+	/* Compare paths to rule out hash collision */
+	char chunk[DIR_CACHE_COMPARE_CHUNK];
+	for (size_t offset = 0; offset < path_length; offset += sizeof(chunk)) {
+		const size_t chunk_length = ((path_length - offset) < sizeof(chunk)) ? (path_length - offset) : sizeof(chunk);
+		if ((f_read(file, chunk, chunk_length, &bytes_read) != FR_OK) || (bytes_read != chunk_length) ||
+			(memcmp(chunk, &path[offset], chunk_length) != 0)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Run merging */
+static size_t reader_read(FIL *file, dir_cache_reader_t *reader, void *buffer, size_t size) {
+	uint8_t *dst = buffer;
+	size_t bytes_copied = 0;
+
+	while (bytes_copied < size) {
+		/* Fetch next part of the run */
+		if (reader->pos == reader->fill) {
+			UINT bytes_read;
+			const FSIZE_t bytes_left = reader->end - reader->offset;
+			if (bytes_left == 0) {
+				break;
+			}
+
+			const UINT chunk = (bytes_left < sizeof(reader->buffer)) ? bytes_left : sizeof(reader->buffer);
+			if ((f_lseek(file, reader->offset) != FR_OK) || (f_read(file, reader->buffer, chunk, &bytes_read) != FR_OK) || (bytes_read == 0)) {
+				reader->error = true;
+				break;
+			}
+
+			reader->offset += bytes_read;
+			reader->fill = bytes_read;
+			reader->pos = 0;
+		}
+
+		size_t chunk = reader->fill - reader->pos;
+		if (chunk > (size - bytes_copied)) {
+			chunk = size - bytes_copied;
+		}
+
+		memcpy(&dst[bytes_copied], &reader->buffer[reader->pos], chunk);
+		reader->pos += chunk;
+		bytes_copied += chunk;
+	}
+
+	return bytes_copied;
+}
+
+static void reader_next(FIL *file, dir_cache_reader_t *reader) {
+	dir_cache_record_t record;
+
+	reader->valid = false;
+
+	const size_t bytes_read = reader_read(file, reader, &record, sizeof(record));
+	if (bytes_read != sizeof(record)) {
+		/* Anything but clean end of the run is an error */
+		if (bytes_read > 0) {
+			reader->error = true;
+		}
+		return;
+	}
+
+	memset(&reader->head.fno, 0, sizeof(FILINFO));
+	if (reader_read(file, reader, reader->head.fno.fname, record.name_length) != record.name_length) {
+		reader->error = true;
+		return;
+	}
+
+	reader->head.fno.fattrib = record.attrib;
+	reader->head.fno.fsize = record.size;
+	make_item(&reader->head);
+	reader->valid = true;
+}
+
+/* Prepares merge of runs delimited by bounds[0]..bounds[ways], heads of the runs are kept in readers between steps */
+static void merge_start(FIL *file, const FSIZE_t *bounds, size_t ways, dir_cache_reader_t *readers) {
+	for (size_t i = 0; i < ways; ++i) {
+		readers[i].offset = bounds[i];
+		readers[i].end = bounds[i + 1];
+		readers[i].pos = 0;
+		readers[i].fill = 0;
+		readers[i].error = false;
+		reader_next(file, &readers[i]);
+	}
+}
+
+/* Passes up to limit records of merged sequence to emit, done is set once all runs are exhausted */
+static FRESULT merge_step(FIL *file, size_t ways, dir_cache_reader_t *readers, dir_cache_emit_t emit, void *user_data, size_t limit, bool *done) {
+	*done = false;
+
+	for (size_t emitted = 0; emitted < limit; ++emitted) {
+		/* Take the smallest head, the earliest run wins on ties, so merge is stable */
+		dir_cache_reader_t *smallest = NULL;
+		for (size_t i = 0; i < ways; ++i) {
+			if (readers[i].error) {
+				return FR_INT_ERR;
+			}
+			if (readers[i].valid && ((smallest == NULL) || compare_ascending(&smallest->head, &readers[i].head))) {
+				smallest = &readers[i];
+			}
+		}
+
+		/* All runs exhausted */
+		if (smallest == NULL) {
+			*done = true;
+			return FR_OK;
+		}
+
+		const FRESULT ret = emit(user_data, &smallest->head.fno);
+		if (ret != FR_OK) {
+			return ret;
+		}
+
+		reader_next(file, smallest);
+	}
+
+	return FR_OK;
+}
+
+static bool runs_push(dir_cache_runs_t *runs, FSIZE_t bound) {
+	if (runs->count == runs->capacity) {
+		const size_t new_capacity = (runs->capacity == 0) ? 16 : (runs->capacity * 2);
+		FSIZE_t *new_bounds = realloc(runs->bounds, new_capacity * sizeof(FSIZE_t));
+		if (new_bounds == NULL) {
+			return false;
+		}
+		runs->bounds = new_bounds;
+		runs->capacity = new_capacity;
+	}
+
+	runs->bounds[runs->count++] = bound;
+	return true;
+}
+
+/* Emitters */
+static FRESULT run_emit(void *user_data, const FILINFO *fno) {
+	return write_record((FIL *)user_data, fno);
+}
+
+static FRESULT index_emit(void *user_data, const FILINFO *fno) {
+	dir_cache_writer_t *writer = (dir_cache_writer_t *)user_data;
+
+	/* First record of a page - note its offset */
+	if ((writer->count % DIR_CACHE_PAGE_ENTRIES) == 0) {
+		const size_t page = writer->count / DIR_CACHE_PAGE_ENTRIES;
+		if (page == writer->page_capacity) {
+			const size_t new_capacity = (writer->page_capacity == 0) ? 16 : (writer->page_capacity * 2);
+			uint32_t *new_offsets = realloc(writer->page_offsets, new_capacity * sizeof(uint32_t));
+			if (new_offsets == NULL) {
+				return FR_NOT_ENOUGH_CORE;
+			}
+			writer->page_offsets = new_offsets;
+			writer->page_capacity = new_capacity;
+		}
+		writer->page_offsets[page] = f_tell(writer->file);
+	}
+
+	writer->count++;
+	return write_record(writer->file, fno);
+}
+
+static void emit_callback(void *data, void *user_data) {
+	dir_cache_emitter_t *emitter = (dir_cache_emitter_t *)user_data;
+
+	if (emitter->ret == FR_OK) {
+		emitter->ret = emitter->emit(emitter->user_data, &((dir_cache_item_t *)data)->fno);
+	}
+}
+
+static FRESULT emit_list(struct list_t *list, dir_cache_emit_t emit, void *user_data) {
+	dir_cache_emitter_t emitter = {.emit = emit, .user_data = user_data, .ret = FR_OK};
+
+	list_sort(list, compare_ascending);
+	list_traverse(list, emit_callback, &emitter, LIST_DIR_FORWARD);
+
+	return emitter.ret;
+}
+
+/* Index build steps */
+static FRESULT open_run_file(dir_cache_builder_t *builder, size_t index) {
+	char run_name[DIR_CACHE_FILE_NAME_LENGTH + 1];
+	char run_path[DIR_CACHE_PATH_LENGTH];
+
+	snprintf(run_name, sizeof(run_name), DIR_CACHE_RUN_FILE, (unsigned int)index);
+	if (get_cache_path(run_path, sizeof(run_path), run_name) != 0) {
+		return FR_INVALID_NAME;
+	}
+
+	const FRESULT ret = f_open(&builder->run_files[index], run_path, FA_CREATE_ALWAYS | FA_READ | FA_WRITE);
+	builder->run_file_open[index] = (ret == FR_OK);
+	return ret;
+}
+
+static void close_run_file(dir_cache_builder_t *builder, size_t index) {
+	char run_name[DIR_CACHE_FILE_NAME_LENGTH + 1];
+	char run_path[DIR_CACHE_PATH_LENGTH];
+
+	if (!builder->run_file_open[index]) {
+		return;
+	}
+
+	f_close(&builder->run_files[index]);
+	builder->run_file_open[index] = false;
+
+	snprintf(run_name, sizeof(run_name), DIR_CACHE_RUN_FILE, (unsigned int)index);
+	if (get_cache_path(run_path, sizeof(run_path), run_name) == 0) {
+		f_unlink(run_path);
+	}
+}
+
+/* Sorts entries read so far and moves them to run file as a new run */
+static FRESULT write_run(dir_cache_builder_t *builder) {
+	FRESULT ret;
+
+	if (!builder->run_file_open[0]) {
+		ret = open_run_file(builder, 0);
+		if ((ret != FR_OK) || !runs_push(&builder->runs, 0)) {
+			return (ret != FR_OK) ? ret : FR_NOT_ENOUGH_CORE;
+		}
+	}
+
+	ret = emit_list(builder->list, run_emit, &builder->run_files[0]);
+	if ((ret != FR_OK) || !runs_push(&builder->runs, f_tell(&builder->run_files[0]))) {
+		return (ret != FR_OK) ? ret : FR_NOT_ENOUGH_CORE;
+	}
+
+	list_destroy(builder->list);
+	builder->list = list_create();
+	builder->entries = 0;
+	return (builder->list != NULL) ? FR_OK : FR_NOT_ENOUGH_CORE;
+}
+
+/* Reads directory until a run of DIR_CACHE_RUN_ENTRIES is sorted. If all the entries fit
+ * in a single run, it's left in the list and nothing is written to run file. */
+static FRESULT build_scan(dir_cache_builder_t *builder) {
+	dir_cache_item_t item;
+	FRESULT ret;
+
+	while (1) {
+		ret = f_readdir(builder->dir, &item.fno);
+		if (ret != FR_OK) {
+			return ret;
+		}
+		if (item.fno.fname[0] == '\0') {
+			break;
+		}
+
+		if (is_cache_dir(builder->path, &item.fno)) {
+			continue;
+		}
+
+		/* Key is computed once per entry, sorting compares keys only */
+		make_item(&item);
+		list_add(builder->list, &item, sizeof(dir_cache_item_t), LIST_APPEND);
+		builder->entries++;
+
+		/* Run full - sort it and move to run file */
+		if (builder->entries == DIR_CACHE_RUN_ENTRIES) {
+			return write_run(builder);
+		}
+	}
+
+	/* Flush the last, incomplete run if runs were written */
+	if (builder->run_file_open[0] && (builder->entries > 0)) {
+		ret = write_run(builder);
+		if (ret != FR_OK) {
+			return ret;
+		}
+	}
+
+	builder->step = BUILD_REDUCE;
+	return FR_OK;
+}
+
+/* Header is written again at the end, when count and page table location are known */
+static FRESULT start_index(dir_cache_builder_t *builder) {
+	UINT bytes_written;
+
+	FRESULT ret = f_open(&builder->index_file, builder->index_path, FA_CREATE_ALWAYS | FA_WRITE);
+	if (ret != FR_OK) {
+		return ret;
+	}
+	builder->index_file_open = true;
+	builder->writer.file = &builder->index_file;
+
+	ret = f_write(&builder->index_file, &builder->header, sizeof(builder->header), &bytes_written);
+	if (ret == FR_OK) {
+		ret = f_write(&builder->index_file, builder->path, builder->header.path_length, &bytes_written);
+	}
+	if (ret != FR_OK) {
+		return ret;
+	}
+
+	/* Records - either straight from the list or merged from runs */
+	if (!builder->run_file_open[builder->src]) {
+		builder->step = BUILD_FINISH;
+		return emit_list(builder->list, index_emit, &builder->writer);
+	}
+
+	builder->ways = builder->runs.count - 1;
+	merge_start(&builder->run_files[builder->src], builder->runs.bounds, builder->ways, builder->readers);
+	builder->step = BUILD_INDEX;
+	return FR_OK;
+}
+
+/* Merges groups of runs until there's few enough of them to be merged into the index at once */
+static FRESULT build_reduce(dir_cache_builder_t *builder) {
+	FRESULT ret;
+	bool done;
+	const size_t dst = 1 - builder->src;
+	const size_t run_count = builder->runs.count - 1;
+
+	/* New pass over all the runs */
+	if (builder->merged.count == 0) {
+		if (!builder->run_file_open[builder->src] || (run_count <= DIR_CACHE_MERGE_WAYS)) {
+			return start_index(builder);
+		}
+
+		ret = open_run_file(builder, dst);
+		if ((ret != FR_OK) || !runs_push(&builder->merged, 0)) {
+			return (ret != FR_OK) ? ret : FR_NOT_ENOUGH_CORE;
+		}
+		builder->next_run = 0;
+		builder->ways = 0;
+	}
+
+	/* Next group of the pass */
+	if (builder->ways == 0) {
+		if (builder->next_run == run_count) {
+			close_run_file(builder, builder->src);
+			free(builder->runs.bounds);
+			builder->runs = builder->merged;
+			memset(&builder->merged, 0, sizeof(dir_cache_runs_t));
+			builder->src = dst;
+			return FR_OK;
+		}
+
+		builder->ways = ((run_count - builder->next_run) < DIR_CACHE_MERGE_WAYS) ? (run_count - builder->next_run) : DIR_CACHE_MERGE_WAYS;
+		merge_start(&builder->run_files[builder->src], &builder->runs.bounds[builder->next_run], builder->ways, builder->readers);
+		builder->next_run += builder->ways;
+	}
+
+	ret = merge_step(&builder->run_files[builder->src], builder->ways, builder->readers, run_emit, &builder->run_files[dst], DIR_CACHE_RUN_ENTRIES, &done);
+	if ((ret == FR_OK) && done) {
+		builder->ways = 0;
+		if (!runs_push(&builder->merged, f_tell(&builder->run_files[dst]))) {
+			return FR_NOT_ENOUGH_CORE;
+		}
+	}
+	return ret;
+}
+
+static FRESULT build_index(dir_cache_builder_t *builder) {
+	bool done;
+
+	const FRESULT ret = merge_step(&builder->run_files[builder->src], builder->ways, builder->readers, index_emit, &builder->writer, DIR_CACHE_RUN_ENTRIES, &done);
+	if ((ret == FR_OK) && done) {
+		builder->step = BUILD_FINISH;
+	}
+	return ret;
+}
+
+/* Page table, then the complete header */
+static FRESULT build_finish(dir_cache_builder_t *builder) {
+	UINT bytes_written;
+	FIL *file = &builder->index_file;
+	dir_cache_writer_t *writer = &builder->writer;
+
+	builder->header.count = writer->count;
+	builder->header.pages_offset = f_tell(file);
+
+	FRESULT ret = f_write(file, writer->page_offsets, DIV_ROUND_UP(writer->count, DIR_CACHE_PAGE_ENTRIES) * sizeof(uint32_t), &bytes_written);
+	if (ret == FR_OK) {
+		ret = f_lseek(file, 0);
+	}
+	if (ret == FR_OK) {
+		ret = f_write(file, &builder->header, sizeof(builder->header), &bytes_written);
+	}
+
+	builder->index_file_open = false;
+	if ((f_close(file) != FR_OK) && (ret == FR_OK)) {
+		ret = FR_DISK_ERR;
+	}
+	if (ret == FR_OK) {
+		builder->step = BUILD_DONE;
+	}
+	return ret;
+}
+
+static void free_builder(dir_cache_builder_t *builder) {
+	/* Don't leave incomplete index behind */
+	if (builder->index_file_open) {
+		f_close(&builder->index_file);
+		f_unlink(builder->index_path);
+	}
+
+	close_run_file(builder, 0);
+	close_run_file(builder, 1);
+	list_destroy(builder->list);
+	free(builder->runs.bounds);
+	free(builder->merged.bounds);
+	free(builder->writer.page_offsets);
+	free(builder->path);
+	free(builder);
+}
+
+int dir_cache_init(const char *root_path) {
+	DWORD free_clusters;
+	FATFS *fs;
+	dir_cache_state_t state;
+	char cache_path[DIR_CACHE_PATH_LENGTH];
+
+	memset(&ctx, 0, sizeof(dir_cache_ctx_t));
+	strncpy(ctx.root_path, root_path, sizeof(ctx.root_path) - 1);
+
+	/* Create cache directory and hide it */
+	if (get_cache_path(cache_path, sizeof(cache_path), "") != 0) {
+		return -ENAMETOOLONG;
+	}
+	cache_path[strlen(cache_path) - 1] = '\0'; // Strip trailing slash
+
+	const FRESULT ret = f_mkdir(cache_path);
+	if ((ret != FR_OK) && (ret != FR_EXIST)) {
+		return -EIO;
+	}
+
+	/* Only when just created, so that boot with valid cache doesn't write anything */
+	if (ret == FR_OK) {
+		f_chmod(cache_path, AM_HID, AM_HID);
+	}
+
+	if (f_getfree(ctx.root_path, &free_clusters, &fs) != FR_OK) {
+		return -EIO;
+	}
+
+	/* Card modified elsewhere, drop all the listings */
+	if (!read_state(&state)) {
+		ctx.generation = 1;
+		update_state();
+	}
+	else if (state.free_clusters != free_clusters) {
+		ctx.generation = state.generation + 1;
+		update_state();
+	}
+	else {
+		ctx.generation = state.generation;
+		ctx.free_clusters = state.free_clusters;
+	}
+
+	ctx.enabled = true;
+	return 0;
+}
+
+int dir_cache_open(dir_cache_t *cache, const char *path, const dir_cache_stamp_t *stamp) {
+	UINT bytes_read;
+	dir_cache_header_t header;
+	char index_path[DIR_CACHE_PATH_LENGTH];
+
+	/* Sanity check */
+	if ((cache == NULL) || (path == NULL) || (stamp == NULL)) {
+		return -EINVAL;
+	}
+
+	if (!ctx.enabled) {
+		return -ENODEV;
+	}
+
+	if (get_index_path(index_path, sizeof(index_path), path) != 0) {
+		return -ENAMETOOLONG;
+	}
+
+	memset(cache, 0, sizeof(dir_cache_t));
+	if (f_open(&cache->file, index_path, FA_READ) != FR_OK) {
+		return -ENOENT;
+	}
+
+	if (!read_header(&cache->file, path, stamp, &header)) {
+		f_close(&cache->file);
+		return -ESTALE;
+	}
+
+	/* Load page table */
+	const size_t table_size = DIV_ROUND_UP(header.count, DIR_CACHE_PAGE_ENTRIES) * sizeof(uint32_t);
+	if (table_size > 0) {
+		cache->page_offsets = malloc(table_size);
+		if (cache->page_offsets == NULL) {
+			f_close(&cache->file);
+			return -ENOMEM;
+		}
+
+		if ((f_lseek(&cache->file, header.pages_offset) != FR_OK) ||
+			(f_read(&cache->file, cache->page_offsets, table_size, &bytes_read) != FR_OK) ||
+			(bytes_read != table_size)) {
+			dir_cache_close(cache);
+			return -EIO;
+		}
+	}
+
+	cache->count = header.count;
+	cache->records_end = header.pages_offset;
+
+	/* Largest page determines the size of names buffer */
+	for (size_t page = 0; page < (table_size / sizeof(uint32_t)); ++page) {
+		const uint32_t page_size = get_page_size(cache, page);
+		if (page_size > cache->max_page_size) {
+			cache->max_page_size = page_size;
+		}
+	}
+
+	return 0;
+}
+
+int dir_cache_build_start(dir_cache_builder_t **builder, DIR *dir, const char *path, const dir_cache_stamp_t *stamp) {
+	/* Sanity check */
+	if ((builder == NULL) || (dir == NULL) || (path == NULL) || (stamp == NULL)) {
+		return -EINVAL;
+	}
+
+	if (!ctx.enabled) {
+		return -ENODEV;
+	}
+
+	dir_cache_builder_t *new_builder = calloc(1, sizeof(dir_cache_builder_t));
+	if (new_builder == NULL) {
+		return -ENOMEM;
+	}
+
+	if (get_index_path(new_builder->index_path, sizeof(new_builder->index_path), path) != 0) {
+		free(new_builder);
+		return -ENAMETOOLONG;
+	}
+
+	new_builder->path = strdup(path);
+	new_builder->list = list_create();
+	if ((new_builder->path == NULL) || (new_builder->list == NULL)) {
+		free_builder(new_builder);
+		return -ENOMEM;
+	}
+
+	new_builder->dir = dir;
+	new_builder->step = BUILD_SCAN;
+	new_builder->header = (dir_cache_header_t) {
+		.magic = DIR_CACHE_MAGIC,
+		.version = DIR_CACHE_VERSION,
+		.path_length = strlen(path),
+		.page_entries = DIR_CACHE_PAGE_ENTRIES,
+		.flags = DIR_CACHE_FLAGS,
+		.generation = ctx.generation,
+		.cluster = stamp->cluster
+	};
+
+	*builder = new_builder;
+	return 0;
+}
+
+int dir_cache_build_step(dir_cache_builder_t *builder) {
+	FRESULT ret;
+
+	/* Sanity check */
+	if (builder == NULL) {
+		return -EINVAL;
+	}
+
+	switch (builder->step) {
+		case BUILD_SCAN:
+			ret = build_scan(builder);
+			break;
+		case BUILD_REDUCE:
+			ret = build_reduce(builder);
+			break;
+		case BUILD_INDEX:
+			ret = build_index(builder);
+			break;
+		case BUILD_FINISH:
+			ret = build_finish(builder);
+			break;
+		default:
+			ret = FR_INT_ERR;
+			break;
+	}
+
+	if (ret != FR_OK) {
+		free_builder(builder);
+		return -EIO;
+	}
+
+	if (builder->step != BUILD_DONE) {
+		return 1;
+	}
+
+	free_builder(builder);
+	return update_state();
+}
+
+void dir_cache_build_abort(dir_cache_builder_t *builder) {
+	if (builder == NULL) {
+		return;
+	}
+
+	free_builder(builder);
+}
+
+int dir_cache_build(DIR *dir, const char *path, const dir_cache_stamp_t *stamp) {
+	dir_cache_builder_t *builder;
+	int ret;
+
+	ret = dir_cache_build_start(&builder, dir, path, stamp);
+	if (ret != 0) {
+		return ret;
+	}
+
+	while ((ret = dir_cache_build_step(builder)) > 0);
+	return ret;
+}
+
+int dir_cache_read_page(dir_cache_t *cache, size_t page, dir_cache_entry_t *entries, char *names) {
+	UINT bytes_read;
+	dir_cache_record_t record;
+
+	/* Sanity check */
+	if ((cache == NULL) || (entries == NULL) || (names == NULL)) {
+		return -EINVAL;
+	}
+
+	const size_t first = page * DIR_CACHE_PAGE_ENTRIES;
+	if (first >= cache->count) {
+		return -EINVAL;
+	}
+
+	const size_t count = ((cache->count - first) < DIR_CACHE_PAGE_ENTRIES) ? (cache->count - first) : DIR_CACHE_PAGE_ENTRIES;
+	const size_t page_size = get_page_size(cache, page);
+
+	/* Records of a page are stored one after another, fetch them at once */
+	if ((f_lseek(&cache->file, cache->page_offsets[page]) != FR_OK) ||
+		(f_read(&cache->file, names, page_size, &bytes_read) != FR_OK) ||
+		(bytes_read != page_size)) {
+		return -EIO;
+	}
+
+	/* Unpack in place - each record header is longer than null-terminator replacing it,
+	 * so unpacked names never overtake records not parsed yet */
+	size_t in = 0;
+	size_t out = 0;
+	for (size_t i = 0; i < count; ++i) {
+		if ((in + sizeof(record)) > page_size) {
+			return -EIO;
+		}
+		memcpy(&record, &names[in], sizeof(record));
+		in += sizeof(record);
+
+		if ((in + record.name_length) > page_size) {
+			return -EIO;
+		}
+		memmove(&names[out], &names[in], record.name_length);
+		in += record.name_length;
+
+		entries[i].name = &names[out];
+		entries[i].size = record.size;
+		entries[i].attrib = record.attrib;
+
+		out += record.name_length;
+		names[out++] = '\0';
+	}
+
+	return count;
+}
+
+void dir_cache_close(dir_cache_t *cache) {
+	if (cache == NULL) {
+		return;
+	}
+
+	f_close(&cache->file);
+	free(cache->page_offsets);
+	memset(cache, 0, sizeof(dir_cache_t));
+}
+
+int dir_cache_get_path(char *buffer, size_t size, const char *file_name) {
+	/* Sanity check */
+	if ((buffer == NULL) || (file_name == NULL)) {
+		return -EINVAL;
+	}
+
+	if (!ctx.enabled) {
+		return -ENODEV;
+	}
+
+	return get_cache_path(buffer, size, file_name);
+}
+
+uint32_t dir_cache_get_generation(void) {
+	return ctx.enabled ? ctx.generation : 0;
+}
+
+int dir_cache_sync_state(void) {
+	DWORD free_clusters;
+	FATFS *fs;
+
+	if (!ctx.enabled) {
+		return -ENODEV;
+	}
+
+	/* Nothing allocated or freed since the state was written, so it's still valid */
+	if (f_getfree(ctx.root_path, &free_clusters, &fs) != FR_OK) {
+		return -EIO;
+	}
+	if (free_clusters == ctx.free_clusters) {
+		return 0;
+	}
+
+	return update_state();
+}
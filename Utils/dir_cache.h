@@ -0,0 +1,88 @@
+/*
+ * dir_cache.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+
+#ifndef DIR_CACHE_H_
+#define DIR_CACHE_H_
+
+#include "fatfs.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Hidden directory in the root of the card where sorted listings are kept */
+#define DIR_CACHE_DIR_NAME ".cache"
+
+/* Length of path buffer for files in cache directory - mount point, directory and 8.3 file name */
+#define DIR_CACHE_PATH_LENGTH 64
+
+/* Number of entries in a single page of the index, pages are the unit of loading names */
+#define DIR_CACHE_PAGE_ENTRIES 8
+
+/* Identifies the directory the listing was made from. Checked together with the card generation, so that
+ * validating an index costs no directory reads. Changes made elsewhere that leave free space unchanged -
+ * renames, empty files, a file replaced by one of the same allocation - aren't detected, the index stays
+ * stale until the generation changes or the cache directory is deleted. */
+typedef struct {
+	uint32_t cluster; // Start cluster of the directory
+} dir_cache_stamp_t;
+
+/* Opened index of a single directory */
+typedef struct {
+	FIL file;
+	uint32_t count; // Number of entries
+	uint32_t records_end; // File offset right after the last record
+	uint32_t max_page_size; // Size of the largest page, enough to hold names of any page
+	uint32_t *page_offsets; // File offset of the first record of each page
+} dir_cache_t;
+
+/* Index build in progress */
+typedef struct dir_cache_builder_t dir_cache_builder_t;
+
+/* Entry of a loaded page, name points into names buffer the page was read to */
+typedef struct {
+	const char *name;
+	uint32_t size;
+	uint8_t attrib;
+} dir_cache_entry_t;
+
+/* Creates cache directory and detects whether the card was modified elsewhere since last run */
+int dir_cache_init(const char *root_path);
+
+/* Opens index of the directory, fails if there's no valid one */
+int dir_cache_open(dir_cache_t *cache, const char *path, const dir_cache_stamp_t *stamp);
+
+/* Reads all the entries of opened directory and stores them sorted as an index. Entries are sorted
+ * in bounded memory - in runs that are merged on the card - so directory size is not limited by RAM. */
+int dir_cache_build(DIR *dir, const char *path, const dir_cache_stamp_t *stamp);
+
+/* The same build split into steps, so that it can be done in slices between other tasks. Directory has to
+ * stay open until the build ends, and only one build may be in progress, as they share temporary files. */
+int dir_cache_build_start(dir_cache_builder_t **builder, DIR *dir, const char *path, const dir_cache_stamp_t *stamp);
+
+/* Reads, sorts or merges up to a run of entries. Returns 1 if there's more to do, 0 once index is
+ * complete or negative error code - builder is freed then. */
+int dir_cache_build_step(dir_cache_builder_t *builder);
+
+/* Stops the build, removing everything written so far */
+void dir_cache_build_abort(dir_cache_builder_t *builder);
+
+/* Reads a page of up to DIR_CACHE_PAGE_ENTRIES entries, returns number of entries read. Names are
+ * stored packed, null-terminated, in names buffer, which has to be at least max_page_size long. */
+int dir_cache_read_page(dir_cache_t *cache, size_t page, dir_cache_entry_t *entries, char *names);
+
+void dir_cache_close(dir_cache_t *cache);
+
+/* Gets path of a file in cache directory, for other modules keeping their data there */
+int dir_cache_get_path(char *buffer, size_t size, const char *file_name);
+
+/* Returns number changing each time the card is modified elsewhere, 0 if cache is unavailable */
+uint32_t dir_cache_get_generation(void);
+
+/* Has to be called after the device modifies the card, otherwise it'd be taken as modified elsewhere on next start.
+ * Writes to the card only if the number of free clusters changed since the last call, so it's cheap to call often. */
+int dir_cache_sync_state(void);
+
+#endif /* DIR_CACHE_H_ */
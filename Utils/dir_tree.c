@@ -0,0 +1,113 @@
+/*
+ * dir_tree.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "dir_tree.h"
+#include "filename.h"
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+/* Appends name to the path of directory on top of the stack, returns new length */
+static size_t append_name(dir_tree_t *tree, const char *name) {
+	const size_t path_length = tree->stack[tree->depth - 1].path_length;
+	const size_t name_length = strlen(name);
+
+	tree->path[path_length] = '/';
+	memcpy(&tree->path[path_length + 1], name, name_length + 1);
+
+	return path_length + 1 + name_length;
+}
+
+static void pop(dir_tree_t *tree) {
+	dir_list_free(tree->list);
+	tree->list = NULL;
+	tree->depth--;
+}
+
+int dir_tree_init(dir_tree_t *tree, const char *path) {
+	/* Sanity check */
+	if ((tree == NULL) || (path == NULL)) {
+		return -EINVAL;
+	}
+
+	const size_t path_length = strlen(path);
+	if (path_length >= DIR_TREE_PATH_LENGTH) {
+		return -ENAMETOOLONG;
+	}
+
+	memset(tree, 0, sizeof(dir_tree_t));
+	memcpy(tree->path, path, path_length + 1);
+	tree->stack[0].path_length = path_length;
+	tree->depth = 1;
+
+	return 0;
+}
+
+int dir_tree_next(dir_tree_t *tree) {
+	/* Sanity check */
+	if (tree == NULL) {
+		return -EINVAL;
+	}
+
+	while (tree->depth > 0) {
+		dir_tree_level_t *level = &tree->stack[tree->depth - 1];
+		tree->path[level->path_length] = '\0';
+
+		/* Just descended or returned - directory has to be listed */
+		if (tree->list == NULL) {
+			tree->list = dir_list_path(tree->path);
+			if (tree->list == NULL) {
+				pop(tree); // Unreadable, skip it
+				continue;
+			}
+		}
+
+		/* Whole directory visited, return to parent */
+		if (level->position >= dir_list_size(tree->list)) {
+			pop(tree);
+			continue;
+		}
+
+		const dir_info_t *info = dir_get_info(tree->list, level->position);
+		level->position++;
+		if (info == NULL) {
+			continue;
+		}
+
+		if (info->attrib & AM_DIR) {
+			const size_t name_length = strlen(info->name);
+			if ((tree->depth >= DIR_TREE_MAX_DEPTH) || ((level->path_length + 1 + name_length) >= DIR_TREE_PATH_LENGTH)) {
+				continue;
+			}
+
+			/* Descend, listing of parent is freed and made again on return */
+			const size_t path_length = append_name(tree, info->name);
+			dir_list_free(tree->list);
+			tree->list = NULL;
+			tree->stack[tree->depth].position = 0;
+			tree->stack[tree->depth].path_length = path_length;
+			tree->depth++;
+		}
+		else if (filename_has_extension(info->name, ".mp3")) {
+			tree->size = info->size;
+			tree->name = &tree->path[level->path_length + 1];
+			append_name(tree, info->name);
+			return 0;
+		}
+	}
+
+	return -ENOENT;
+}
+
+void dir_tree_close(dir_tree_t *tree) {
+	if (tree == NULL) {
+		return;
+	}
+
+	dir_list_free(tree->list);
+	tree->list = NULL;
+	tree->depth = 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * dir_tree.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+
+#ifndef DIR_TREE_H_
+#define DIR_TREE_H_
+
+#include "dir.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Deeper directories are skipped */
+#define DIR_TREE_MAX_DEPTH 16
+
+/* Max length of directory path, directories with longer ones are skipped */
+#define DIR_TREE_PATH_LENGTH 256
+
+typedef struct {
+	dir_entry_t position; // Next entry of the directory to be visited
+	size_t path_length; // Length of the directory path
+} dir_tree_level_t;
+
+/* Depth-first walk over MP3 files beneath a directory, in sorted order. Only a stack of positions and
+ * listing of the directory being walked are kept, so memory use doesn't depend on size of the tree. */
+typedef struct {
+	dir_list_t *list; // Listing of the directory on top of the stack, others are listed again on return
+	dir_tree_level_t stack[DIR_TREE_MAX_DEPTH];
+	size_t depth;
+	uint32_t size; // Size of the current file
+	const char *name; // Name of the current file, points into path
+	char path[DIR_TREE_PATH_LENGTH + _MAX_LFN + 2]; // Path of the current file, additional '/' and null-terminator
+} dir_tree_t;
+
+int dir_tree_init(dir_tree_t *tree, const char *path);
+
+/* Moves to the next MP3 file, its path, name and size are then available in the tree. Returns -ENOENT after the last one. */
+int dir_tree_next(dir_tree_t *tree);
+
+void dir_tree_close(dir_tree_t *tree);
+
+#endif /* DIR_TREE_H_ */
@@ -0,0 +1,14 @@
+/*
+ * filename.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "filename.h"
+#include <string.h>
+#include <strings.h>
+
+bool filename_has_extension(const char *name, const char *ext) {
+	const char *dot_ptr = strrchr(name, '.');
+	return ((dot_ptr != NULL) && (strcasecmp(dot_ptr, ext) == 0));
+}
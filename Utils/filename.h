@@ -0,0 +1,16 @@
+/*
+ * filename.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+
+#ifndef FILENAME_H_
+#define FILENAME_H_
+
+#include <stdbool.h>
+
+/* Checks extension of file name or path, case-insensitive, ext includes the dot */
+bool filename_has_extension(const char *name, const char *ext);
+
+#endif /* FILENAME_H_ */
@@ -0,0 +1,544 @@
+/*
+ * library.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "library.h"
+#include "dir_cache.h"
+#include "scheduler.h"
+#include "filename.h"
+#include <string.h>
+#include <errno.h>
+
+#define LIBRARY_MAGIC 0x4442494C // "LIBD"
+#define LIBRARY_VERSION 1
+
+#define LIBRARY_DB_FILE "library.db"
+#define LIBRARY_TRACKS_FILE "library.trk"
+#define LIBRARY_QUEUE_FILE "scan.tmp"
+
+#define LIBRARY_RECORD_DIR 0x01
+#define LIBRARY_RECORD_TRACK 0x02
+
+#define LIBRARY_SYNC_INTERVAL 16384 // Bytes appended to database between syncs of the scan files and cache state
+
+/* Database layout: header followed by directory and track records in the order they were found.
+ * Separate tracks file holds offsets of track records, so that track can be found by its index.
+ * Magic is written when the scan completes, so interrupted scan leaves invalid database. */
+typedef struct __attribute__((packed)) {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t reserved;
+	uint32_t generation;
+	uint32_t track_count;
+	uint32_t dir_count;
+} library_header_t;
+
+/* Followed by path relative to root, without null-terminator */
+typedef struct __attribute__((packed)) {
+	uint8_t type;
+	uint8_t reserved;
+	uint16_t path_length;
+} library_dir_record_t;
+
+/* Followed by name, title and artist, without null-terminators */
+typedef struct __attribute__((packed)) {
+	uint8_t type;
+	uint8_t name_length;
+	uint8_t title_length;
+	uint8_t artist_length;
+	uint32_t dir;
+	uint32_t size;
+	uint32_t duration;
+	uint32_t sample_rate;
+} library_track_record_t;
+
+typedef enum {
+	SCAN_START,
+	SCAN_NEXT_DIR,
+	SCAN_READ_DIR,
+	SCAN_FINISH
+} library_scan_t;
+
+typedef struct {
+	library_state_t state;
+	library_scan_t scan;
+	uint32_t generation;
+	uint32_t track_count;
+	uint32_t dir_count;
+	uint32_t db_end; // Offset of the end of database, where records are appended
+	uint32_t synced_end; // Database end at the last sync
+	uint32_t queue_pos; // Index of the next directory to be scanned in the queue file
+	library_track_t current_dir; // Directory being scanned
+	size_t root_length;
+	char path[LIBRARY_PATH_LENGTH]; // Path of directory being scanned
+	FIL db;
+	FIL tracks;
+	FIL queue; // Directories found, but not scanned yet
+	FIL file; // Track being examined
+	DIR dir;
+	FILINFO fno;
+} library_ctx_t;
+
+static library_ctx_t ctx;
+
+static int read_at(FIL *file, uint32_t offset, void *buffer, size_t size) {
+	UINT bytes_read;
+
+	if ((f_lseek(file, offset) != FR_OK) || (f_read(file, buffer, size, &bytes_read) != FR_OK) || (bytes_read != size)) {
+		return -EIO;
+	}
+	return 0;
+}
+
+static int write_at(FIL *file, uint32_t offset, const void *buffer, size_t size) {
+	UINT bytes_written;
+
+	if ((f_lseek(file, offset) != FR_OK) || (f_write(file, buffer, size, &bytes_written) != FR_OK) || (bytes_written != size)) {
+		return -EIO;
+	}
+	return 0;
+}
+
+static int append_db(const void *buffer, size_t size) {
+	const int ret = write_at(&ctx.db, ctx.db_end, buffer, size);
+	if (ret == 0) {
+		ctx.db_end += size;
+	}
+	return ret;
+}
+
+static int write_header(uint32_t magic) {
+	const library_header_t header = {
+		.magic = magic,
+		.version = LIBRARY_VERSION,
+		.generation = ctx.generation,
+		.track_count = ctx.track_count,
+		.dir_count = ctx.dir_count
+	};
+
+	return write_at(&ctx.db, 0, &header, sizeof(header));
+}
+
+static int open_file(FIL *file, const char *name, BYTE mode) {
+	char path[DIR_CACHE_PATH_LENGTH];
+
+	if (dir_cache_get_path(path, sizeof(path), name) != 0) {
+		return -ENAMETOOLONG;
+	}
+	return (f_open(file, path, mode) == FR_OK) ? 0 : -EIO;
+}
+
+/* Appends '/' and name to the path being scanned, returns previous path length to restore it */
+static int path_push(const char *name) {
+	const size_t path_length = strlen(ctx.path);
+	const size_t name_length = strlen(name);
+
+	if ((path_length + name_length + 2) > sizeof(ctx.path)) {
+		return -ENAMETOOLONG;
+	}
+
+	ctx.path[path_length] = '/';
+	memcpy(&ctx.path[path_length + 1], name, name_length + 1);
+	return path_length;
+}
+
+/* Clusters allocated to scan files have to be recorded in cache state, otherwise scan interrupted
+ * by power loss would look like the card was modified elsewhere and invalidate all the listings */
+static int sync_scan(void) {
+	if ((f_sync(&ctx.db) != FR_OK) || (f_sync(&ctx.tracks) != FR_OK) || (f_sync(&ctx.queue) != FR_OK)) {
+		return -EIO;
+	}
+
+	ctx.synced_end = ctx.db_end;
+	dir_cache_sync_state();
+	return 0;
+}
+
+static void close_files(void) {
+	f_close(&ctx.db);
+	f_close(&ctx.tracks);
+	f_close(&ctx.queue);
+}
+
+static bool open_database(void) {
+	library_header_t header;
+
+	if (open_file(&ctx.db, LIBRARY_DB_FILE, FA_READ) != 0) {
+		return false;
+	}
+	if (open_file(&ctx.tracks, LIBRARY_TRACKS_FILE, FA_READ) != 0) {
+		f_close(&ctx.db);
+		return false;
+	}
+
+	/* Scan has to be complete and done after the last modification of the card */
+	if ((read_at(&ctx.db, 0, &header, sizeof(header)) != 0) ||
+		(header.magic != LIBRARY_MAGIC) ||
+		(header.version != LIBRARY_VERSION) ||
+		(header.generation != ctx.generation) ||
+		(f_size(&ctx.tracks) != (header.track_count * sizeof(library_track_t)))) {
+		f_close(&ctx.db);
+		f_close(&ctx.tracks);
+		return false;
+	}
+
+	ctx.track_count = header.track_count;
+	ctx.dir_count = header.dir_count;
+	return true;
+}
+
+/* Scanning steps */
+static int add_dir(const char *path) {
+	UINT bytes_written;
+
+	const size_t path_length = strlen(path);
+	const library_dir_record_t record = {
+		.type = LIBRARY_RECORD_DIR,
+		.path_length = path_length
+	};
+	const library_track_t offset = ctx.db_end;
+
+	if ((append_db(&record, sizeof(record)) != 0) || (append_db(path, path_length) != 0)) {
+		return -EIO;
+	}
+
+	/* Queue it for scanning */
+	if ((f_lseek(&ctx.queue, f_size(&ctx.queue)) != FR_OK) || (f_write(&ctx.queue, &offset, sizeof(offset), &bytes_written) != FR_OK)) {
+		return -EIO;
+	}
+
+	ctx.dir_count++;
+	return 0;
+}
+
+static size_t track_read(void *user_data, uint32_t offset, void *buffer, size_t size) {
+	UINT bytes_read;
+	FIL *file = (FIL *)user_data;
+
+	if ((f_lseek(file, offset) != FR_OK) || (f_read(file, buffer, size, &bytes_read) != FR_OK)) {
+		return 0;
+	}
+	return bytes_read;
+}
+
+static int add_track(const FILINFO *fno) {
+	UINT bytes_written;
+	mp3_info_t info;
+
+	/* Track path is the directory path, then '/' and name */
+	const int path_length = path_push(fno->fname);
+	if (path_length < 0) {
+		return 0;
+	}
+
+	const FRESULT ret = f_open(&ctx.file, ctx.path, FA_READ);
+	ctx.path[path_length] = '\0';
+	if (ret != FR_OK) {
+		return 0; // Unreadable file is just skipped
+	}
+
+	const int info_ret = mp3_info_parse(&info, fno->fsize, track_read, &ctx.file);
+	f_close(&ctx.file);
+	if (info_ret != 0) {
+		return 0;
+	}
+
+	const library_track_record_t record = {
+		.type = LIBRARY_RECORD_TRACK,
+		.name_length = strlen(fno->fname),
+		.title_length = strlen(info.title),
+		.artist_length = strlen(info.artist),
+		.dir = ctx.current_dir,
+		.size = fno->fsize,
+		.duration = info.duration,
+		.sample_rate = info.sample_rate
+	};
+	const library_track_t offset = ctx.db_end;
+
+	if ((append_db(&record, sizeof(record)) != 0) ||
+		(append_db(fno->fname, record.name_length) != 0) ||
+		(append_db(info.title, record.title_length) != 0) ||
+		(append_db(info.artist, record.artist_length) != 0)) {
+		return -EIO;
+	}
+
+	/* Tracks file is only appended to while scanning */
+	if ((f_write(&ctx.tracks, &offset, sizeof(offset), &bytes_written) != FR_OK) || (bytes_written != sizeof(offset))) {
+		return -EIO;
+	}
+
+	ctx.track_count++;
+	return 0;
+}
+
+static int scan_start(void) {
+	ctx.track_count = 0;
+	ctx.dir_count = 0;
+	ctx.queue_pos = 0;
+	ctx.db_end = sizeof(library_header_t);
+
+	if (open_file(&ctx.db, LIBRARY_DB_FILE, FA_CREATE_ALWAYS | FA_READ | FA_WRITE) != 0) {
+		return -EIO;
+	}
+	if (open_file(&ctx.tracks, LIBRARY_TRACKS_FILE, FA_CREATE_ALWAYS | FA_READ | FA_WRITE) != 0) {
+		f_close(&ctx.db);
+		return -EIO;
+	}
+	if (open_file(&ctx.queue, LIBRARY_QUEUE_FILE, FA_CREATE_ALWAYS | FA_READ | FA_WRITE) != 0) {
+		f_close(&ctx.db);
+		f_close(&ctx.tracks);
+		return -EIO;
+	}
+
+	/* Root directory has empty relative path */
+	if ((write_header(0) != 0) || (add_dir("") != 0) || (sync_scan() != 0)) {
+		return -EIO;
+	}
+
+	ctx.scan = SCAN_NEXT_DIR;
+	return 0;
+}
+
+static int scan_next_dir(void) {
+	library_dir_record_t record;
+
+	/* Queue drained, whole card scanned */
+	if ((ctx.queue_pos * sizeof(library_track_t)) >= f_size(&ctx.queue)) {
+		ctx.scan = SCAN_FINISH;
+		return 0;
+	}
+
+	if (((ctx.db_end - ctx.synced_end) >= LIBRARY_SYNC_INTERVAL) && (sync_scan() != 0)) {
+		return -EIO;
+	}
+
+	if (read_at(&ctx.queue, ctx.queue_pos * sizeof(library_track_t), &ctx.current_dir, sizeof(ctx.current_dir)) != 0) {
+		return -EIO;
+	}
+	ctx.queue_pos++;
+
+	if ((read_at(&ctx.db, ctx.current_dir, &record, sizeof(record)) != 0) ||
+		((ctx.root_length + record.path_length) >= sizeof(ctx.path)) ||
+		(read_at(&ctx.db, ctx.current_dir + sizeof(record), &ctx.path[ctx.root_length], record.path_length) != 0)) {
+		return -EIO;
+	}
+	ctx.path[ctx.root_length + record.path_length] = '\0';
+
+	/* Directory that can't be opened is skipped */
+	if (f_opendir(&ctx.dir, ctx.path) == FR_OK) {
+		ctx.scan = SCAN_READ_DIR;
+	}
+	return 0;
+}
+
+static int scan_read_dir(void) {
+	FILINFO *fno = &ctx.fno;
+
+	const FRESULT ret = f_readdir(&ctx.dir, fno);
+	if ((ret != FR_OK) || (fno->fname[0] == '\0')) {
+		f_closedir(&ctx.dir);
+		ctx.scan = SCAN_NEXT_DIR;
+		return 0;
+	}
+
+	/* Hidden and system entries are skipped, cache directory among them */
+	if (fno->fattrib & (AM_HID | AM_SYS)) {
+		return 0;
+	}
+
+	if (fno->fattrib & AM_DIR) {
+		const int path_length = path_push(fno->fname);
+		if (path_length < 0) {
+			return 0; // Path too long, skip it
+		}
+
+		const int add_ret = add_dir(&ctx.path[ctx.root_length]);
+		ctx.path[path_length] = '\0';
+		return add_ret;
+	}
+
+	if (filename_has_extension(fno->fname, ".mp3")) {
+		return add_track(fno);
+	}
+
+	return 0;
+}
+
+static int scan_finish(void) {
+	char path[DIR_CACHE_PATH_LENGTH];
+
+	f_close(&ctx.queue);
+	if (dir_cache_get_path(path, sizeof(path), LIBRARY_QUEUE_FILE) == 0) {
+		f_unlink(path);
+	}
+
+	if ((write_header(LIBRARY_MAGIC) != 0) || (f_sync(&ctx.db) != FR_OK) || (f_sync(&ctx.tracks) != FR_OK)) {
+		return -EIO;
+	}
+
+	/* Database written by the device doesn't mean the card was modified elsewhere */
+	dir_cache_sync_state();
+
+	ctx.state = LIBRARY_READY;
+	return 0;
+}
+
+static int scan_step(void) {
+	switch (ctx.scan) {
+		case SCAN_START:
+			return scan_start();
+		case SCAN_NEXT_DIR:
+			return scan_next_dir();
+		case SCAN_READ_DIR:
+			return scan_read_dir();
+		case SCAN_FINISH:
+			return scan_finish();
+		default:
+			return -EINVAL;
+	}
+}
+
+void library_init(const char *root_path) {
+	memset(&ctx, 0, sizeof(library_ctx_t));
+
+	/* Database lives in cache directory and relies on its modification detection */
+	ctx.generation = dir_cache_get_generation();
+	ctx.root_length = strlen(root_path);
+	if ((ctx.generation == 0) || (ctx.root_length >= sizeof(ctx.path))) {
+		ctx.state = LIBRARY_DISABLED;
+		return;
+	}
+	strcpy(ctx.path, root_path);
+
+	if (open_database()) {
+		ctx.state = LIBRARY_READY;
+		return;
+	}
+
+	/* Scan in the background */
+	ctx.state = LIBRARY_SCANNING;
+	ctx.scan = SCAN_START;
+}
+
+library_state_t library_get_state(void) {
+	return ctx.state;
+}
+
+size_t library_get_track_count(void) {
+	return (ctx.state == LIBRARY_READY) ? ctx.track_count : 0;
+}
+
+int library_get_track(size_t index, library_track_t *track) {
+	/* Sanity check */
+	if (track == NULL) {
+		return -EINVAL;
+	}
+
+	if (ctx.state != LIBRARY_READY) {
+		return -EBUSY;
+	}
+
+	if (index >= ctx.track_count) {
+		return -EINVAL;
+	}
+
+	return read_at(&ctx.tracks, index * sizeof(library_track_t), track, sizeof(library_track_t));
+}
+
+int library_get_track_info(library_track_t track, library_track_info_t *info) {
+	library_track_record_t record;
+
+	/* Sanity check */
+	if (info == NULL) {
+		return -EINVAL;
+	}
+
+	if (ctx.state != LIBRARY_READY) {
+		return -EBUSY;
+	}
+
+	if ((read_at(&ctx.db, track, &record, sizeof(record)) != 0) || (record.type != LIBRARY_RECORD_TRACK)) {
+		return -EIO;
+	}
+
+	/* Strings follow the record, f_read continues right after it */
+	UINT bytes_read;
+	const uint8_t lengths[] = {record.name_length, record.title_length, record.artist_length};
+	char *const strings[] = {info->name, info->title, info->artist};
+	for (size_t i = 0; i < (sizeof(lengths) / sizeof(lengths[0])); ++i) {
+		if ((f_read(&ctx.db, strings[i], lengths[i], &bytes_read) != FR_OK) || (bytes_read != lengths[i])) {
+			return -EIO;
+		}
+		strings[i][lengths[i]] = '\0';
+	}
+
+	info->dir = record.dir;
+	info->size = record.size;
+	info->duration = record.duration;
+	info->sample_rate = record.sample_rate;
+	return 0;
+}
+
+int library_get_track_path(library_track_t track, char *buffer, size_t size) {
+	library_track_record_t track_record;
+	library_dir_record_t dir_record;
+
+	/* Sanity check */
+	if (buffer == NULL) {
+		return -EINVAL;
+	}
+
+	if (ctx.state != LIBRARY_READY) {
+		return -EBUSY;
+	}
+
+	if ((read_at(&ctx.db, track, &track_record, sizeof(track_record)) != 0) || (track_record.type != LIBRARY_RECORD_TRACK) ||
+		(read_at(&ctx.db, track_record.dir, &dir_record, sizeof(dir_record)) != 0) || (dir_record.type != LIBRARY_RECORD_DIR)) {
+		return -EIO;
+	}
+
+	/* Root path, directory path, '/', name and null-terminator */
+	const size_t dir_offset = ctx.root_length;
+	const size_t name_offset = dir_offset + dir_record.path_length + 1;
+	if ((name_offset + track_record.name_length + 1) > size) {
+		return -ENAMETOOLONG;
+	}
+
+	memcpy(buffer, ctx.path, ctx.root_length);
+	if ((read_at(&ctx.db, track_record.dir + sizeof(dir_record), &buffer[dir_offset], dir_record.path_length) != 0) ||
+		(read_at(&ctx.db, track + sizeof(track_record), &buffer[name_offset], track_record.name_length) != 0)) {
+		return -EIO;
+	}
+	buffer[name_offset - 1] = '/';
+	buffer[name_offset + track_record.name_length] = '\0';
+	return 0;
+}
+
+void library_task(void) {
+	if (ctx.state != LIBRARY_SCANNING) {
+		return;
+	}
+
+	/* Yield as soon as the audio buffer needs data or the slice budget is used up */
+	do {
+		if (scan_step() != 0) {
+			/* Card unusable for the database, give up until next start */
+			f_closedir(&ctx.dir);
+			close_files();
+			ctx.state = LIBRARY_DISABLED;
+			return;
+		}
+	} while ((ctx.state == LIBRARY_SCANNING) && !scheduler_should_yield());
+}
+
+void library_deinit(void) {
+	if (ctx.state == LIBRARY_SCANNING) {
+		f_closedir(&ctx.dir);
+	}
+	if (ctx.state != LIBRARY_DISABLED) {
+		close_files();
+	}
+	ctx.state = LIBRARY_DISABLED;
+}
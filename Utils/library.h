@@ -0,0 +1,58 @@
+/*
+ * library.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+
+#ifndef LIBRARY_H_
+#define LIBRARY_H_
+
+#include "fatfs.h"
+#include "mp3_info.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Max length of track path, longer ones are skipped by the scanner */
+#define LIBRARY_PATH_LENGTH 256
+
+/* Reference to a track - offset of its record in the database */
+typedef uint32_t library_track_t;
+
+typedef struct {
+	library_track_t dir; // Reference to the directory the track is in
+	uint32_t size; // Bytes
+	uint32_t duration; // Seconds
+	uint32_t sample_rate; // Hz
+	char name[_MAX_LFN + 1];
+	char title[MP3_INFO_TAG_LENGTH + 1];
+	char artist[MP3_INFO_TAG_LENGTH + 1];
+} library_track_info_t;
+
+typedef enum {
+	LIBRARY_DISABLED,
+	LIBRARY_SCANNING,
+	LIBRARY_READY
+} library_state_t;
+
+/* Opens track database kept in cache directory, schedules rescan if it's missing or the card has been modified elsewhere */
+void library_init(const char *root_path);
+
+library_state_t library_get_state(void);
+
+/* Number of tracks, 0 until scan is done */
+size_t library_get_track_count(void);
+
+/* Gets reference to track with given index, tracks are numbered in the order they were found */
+int library_get_track(size_t index, library_track_t *track);
+
+int library_get_track_info(library_track_t track, library_track_info_t *info);
+int library_get_track_path(library_track_t track, char *buffer, size_t size);
+
+/* Scans a part of the card, returns once scheduler asks to yield - when slice budget is used up or audio buffer needs refilling */
+void library_task(void);
+
+void library_deinit(void);
+
+#endif /* LIBRARY_H_ */
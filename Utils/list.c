@@ -56,11 +56,48 @@ void list_add(struct list_t *list, void *data, size_t data_size, enum list_pos_t
     }
 }
 
-void list_sort(struct list_t *list, bool (*compare)(const void *, const void *)) {
-	bool sorted = true;
-	struct list_node_t *current;
-	struct list_node_t *last = NULL;
+/* Merges two sorted chains of nodes linked by next pointers, left chain wins ties to keep the sort stable */
+static struct list_node_t *merge(struct list_node_t *left, struct list_node_t *right, bool (*compare)(const void *, const void *), struct list_node_t **tail) {
+	struct list_node_t head;
+	struct list_node_t *last = &head;
+
+	while ((left != NULL) && (right != NULL)) {
+		if (compare(left->data, right->data)) {
+			last->next = right;
+			right = right->next;
+		}
+		else {
+			last->next = left;
+			left = left->next;
+		}
+		last = last->next;
+	}
+
+	last->next = (left != NULL) ? left : right;
+	while (last->next != NULL) {
+		last = last->next;
+	}
+
+	*tail = last;
+	return head.next;
+}
+
+/* Detaches chain of up to length nodes from the beginning of list, returns the rest */
+static struct list_node_t *split(struct list_node_t *list, size_t length) {
+	for (size_t i = 1; (list != NULL) && (i < length); ++i) {
+		list = list->next;
+	}
+
+	if (list == NULL) {
+		return NULL;
+	}
+
+	struct list_node_t *rest = list->next;
+	list->next = NULL;
+	return rest;
+}
 
+void list_sort(struct list_t *list, bool (*compare)(const void *, const void *)) {
 	/* Sanity check */
 	if ((list == NULL) || (compare == NULL)) {
 		return;
@@ -71,25 +108,46 @@ void list_sort(struct list_t *list, bool (*compare)(const void *, const void *))
 		return;
 	}
 
-	/* Bubble sort algorithm - complexity shouldn't matter in such small datasets */
-	do {
-		sorted = true;
-		current = list->head;
-
-		while (current->next != last) {
-			if (compare(current->data, current->next->data)) {
-				/* Swap data pointers */
-				void *temp = current->data;
-				current->data = current->next->data;
-				current->next->data = temp;
-
-				sorted = false;
+	/* Bottom-up merge sort - O(n log n) compares, no recursion and no extra memory. Nodes are
+	 * relinked using next pointers only, prev pointers are restored in the end. */
+	size_t width = 1;
+	while (1) {
+		struct list_node_t *rest = list->head;
+		struct list_node_t *tail = NULL;
+		size_t merges = 0;
+
+		list->head = NULL;
+		while (rest != NULL) {
+			struct list_node_t *left = rest;
+			struct list_node_t *right = split(left, width);
+			rest = split(right, width);
+
+			struct list_node_t *merged_tail;
+			struct list_node_t *merged = merge(left, right, compare, &merged_tail);
+			if (tail == NULL) {
+				list->head = merged;
 			}
-			current = current->next;
+			else {
+				tail->next = merged;
+			}
+			tail = merged_tail;
+			merges++;
 		}
-		last = current;
 
-	} while (!sorted);
+		/* Single merge means whole list is sorted */
+		if (merges <= 1) {
+			break;
+		}
+		width *= 2;
+	}
+
+	/* Restore backward links */
+	struct list_node_t *prev = NULL;
+	for (struct list_node_t *current = list->head; current != NULL; current = current->next) {
+		current->prev = prev;
+		prev = current;
+	}
+	list->tail = prev;
 }
 
 void list_traverse(struct list_t *list, void (*callback)(void *, void *), void *data, enum list_dir_t direction) {
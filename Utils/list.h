@@ -27,6 +27,7 @@ enum list_pos_t {
 struct list_t *list_create(void);
 
 void list_add(struct list_t *list, void *data, size_t data_size, enum list_pos_t position);
+/* Stable, O(n log n) sort - compare returns true if first element has to be placed after the second one */
 void list_sort(struct list_t *list, bool (*compare)(const void *, const void *));
 void list_traverse(struct list_t *list, void (*callback)(void *, void *), void *data, enum list_dir_t direction);
 
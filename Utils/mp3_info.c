@@ -0,0 +1,256 @@
+/*
+ * mp3_info.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "mp3_info.h"
+#include "ff.h"
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#define MP3_INFO_ID3V2_HEADER_SIZE 10
+#define MP3_INFO_ID3V2_FOOTER_FLAG 0x10
+#define MP3_INFO_ID3V2_EXTENDED_FLAG 0x40
+#define MP3_INFO_ID3V2_MAX_FRAMES 32 // Frames looked through for title and artist, bounds the reads done per file
+#define MP3_INFO_ID3V1_SIZE 128
+#define MP3_INFO_ID3V1_FIELD_LENGTH 30
+#define MP3_INFO_ID3V1_TITLE_OFFSET 3
+#define MP3_INFO_ID3V1_ARTIST_OFFSET 33
+
+#define MP3_INFO_FRAME_BUFFER_SIZE 128 // Part of text frame decoded, enough for MP3_INFO_TAG_LENGTH characters in any encoding
+#define MP3_INFO_SYNC_SEARCH_SIZE 512 // Bytes searched for the first frame header
+#define MP3_INFO_FRAME_HEADER_SIZE 4
+#define MP3_INFO_VBRI_OFFSET 32 // Offset of VBRI header from the end of frame header
+#define MP3_INFO_XING_FRAMES_FLAG 0x01
+
+typedef enum {
+	TEXT_LATIN1,
+	TEXT_UTF16,
+	TEXT_UTF16BE,
+	TEXT_UTF8
+} text_encoding_t;
+
+static const uint16_t bitrates_mpeg1[16] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0};
+static const uint16_t bitrates_mpeg2[16] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0};
+static const uint32_t sample_rates_mpeg1[4] = {44100, 48000, 32000, 0};
+
+static uint32_t get_be32(const uint8_t *data) {
+	return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
+
+static uint32_t get_syncsafe32(const uint8_t *data) {
+	return ((uint32_t)(data[0] & 0x7F) << 21) | ((uint32_t)(data[1] & 0x7F) << 14) | ((uint32_t)(data[2] & 0x7F) << 7) | (data[3] & 0x7F);
+}
+
+static void put_char(char *dst, size_t *length, WCHAR chr) {
+	if (*length >= MP3_INFO_TAG_LENGTH) {
+		return;
+	}
+
+	/* Map to code page of the file system, unrepresentable characters become '?' */
+	if (chr >= 0x80) {
+		chr = ff_convert(chr, 0);
+	}
+	dst[(*length)++] = ((chr == 0) || (chr > 0xFF)) ? '?' : (char)chr;
+	dst[*length] = '\0';
+}
+
+static void decode_text(char *dst, const uint8_t *src, size_t size, text_encoding_t encoding) {
+	size_t length = 0;
+	size_t pos = 0;
+	bool little_endian = false;
+
+	dst[0] = '\0';
+
+	/* Byte order mark */
+	if ((encoding == TEXT_UTF16) && (size >= 2)) {
+		little_endian = (src[0] == 0xFF) && (src[1] == 0xFE);
+		pos = 2;
+	}
+
+	while (pos < size) {
+		uint32_t chr;
+
+		switch (encoding) {
+			case TEXT_UTF16:
+			case TEXT_UTF16BE:
+				if ((pos + 1) >= size) {
+					return;
+				}
+				chr = little_endian ? (src[pos] | (src[pos + 1] << 8)) : ((src[pos] << 8) | src[pos + 1]);
+				pos += 2;
+				break;
+
+			case TEXT_UTF8: {
+				size_t extra = (src[pos] >= 0xF0) ? 3 : (src[pos] >= 0xE0) ? 2 : (src[pos] >= 0xC0) ? 1 : 0;
+				chr = (extra == 0) ? src[pos] : (src[pos] & (0x3F >> extra));
+				pos++;
+				while ((extra-- > 0) && (pos < size)) {
+					chr = (chr << 6) | (src[pos++] & 0x3F);
+				}
+			} break;
+
+			default:
+				chr = src[pos++];
+				break;
+		}
+
+		/* Text is null-terminated or padded with nulls */
+		if (chr == 0) {
+			break;
+		}
+		put_char(dst, &length, (chr > 0xFFFF) ? '?' : chr);
+	}
+
+	/* Trim padding spaces */
+	while ((length > 0) && (dst[length - 1] == ' ')) {
+		dst[--length] = '\0';
+	}
+}
+
+/* Returns offset right after the tag, 0 if there's no tag */
+static uint32_t parse_id3v2(mp3_info_t *info, mp3_info_read_t read, void *user_data) {
+	uint8_t header[MP3_INFO_ID3V2_HEADER_SIZE];
+	uint8_t frame[MP3_INFO_FRAME_BUFFER_SIZE];
+
+	if ((read(user_data, 0, header, sizeof(header)) != sizeof(header)) || (memcmp(header, "ID3", 3) != 0)) {
+		return 0;
+	}
+
+	const uint8_t version = header[3];
+	const uint8_t flags = header[5];
+	const uint32_t tag_end = MP3_INFO_ID3V2_HEADER_SIZE + get_syncsafe32(&header[6]);
+	uint32_t pos = MP3_INFO_ID3V2_HEADER_SIZE;
+	size_t frames = 0;
+
+	/* Only v2.3 and v2.4 frames are supported, older tag is just skipped */
+	if ((version != 3) && (version != 4)) {
+		pos = tag_end;
+	}
+
+	/* Skip extended header */
+	if ((pos < tag_end) && (flags & MP3_INFO_ID3V2_EXTENDED_FLAG)) {
+		if (read(user_data, pos, frame, 4) != 4) {
+			return tag_end;
+		}
+		pos += (version == 4) ? get_syncsafe32(frame) : (get_be32(frame) + 4);
+	}
+
+	/* Tag can be up to 256MiB of any number of frames, title and artist are usually among the first ones */
+	while (((pos + MP3_INFO_ID3V2_HEADER_SIZE) <= tag_end) && ((info->title[0] == '\0') || (info->artist[0] == '\0')) &&
+		   (frames++ < MP3_INFO_ID3V2_MAX_FRAMES)) {
+		if (read(user_data, pos, header, sizeof(header)) != sizeof(header)) {
+			break;
+		}
+
+		/* Padding reached */
+		if (header[0] == '\0') {
+			break;
+		}
+
+		const uint32_t frame_size = (version == 4) ? get_syncsafe32(&header[4]) : get_be32(&header[4]);
+		if (frame_size > (tag_end - pos - MP3_INFO_ID3V2_HEADER_SIZE)) {
+			break; // Corrupted tag
+		}
+		pos += MP3_INFO_ID3V2_HEADER_SIZE;
+
+		char *dst = (memcmp(header, "TIT2", 4) == 0) ? info->title : (memcmp(header, "TPE1", 4) == 0) ? info->artist : NULL;
+		if ((dst != NULL) && (frame_size > 1)) {
+			const size_t size = (frame_size < sizeof(frame)) ? frame_size : sizeof(frame);
+			if (read(user_data, pos, frame, size) == size) {
+				decode_text(dst, &frame[1], size - 1, (frame[0] <= TEXT_UTF8) ? (text_encoding_t)frame[0] : TEXT_LATIN1);
+			}
+		}
+		pos += frame_size;
+	}
+
+	return tag_end + ((flags & MP3_INFO_ID3V2_FOOTER_FLAG) ? MP3_INFO_ID3V2_HEADER_SIZE : 0);
+}
+
+/* Returns true if ID3v1 tag is present */
+static bool parse_id3v1(mp3_info_t *info, uint32_t file_size, mp3_info_read_t read, void *user_data) {
+	uint8_t tag[MP3_INFO_ID3V1_SIZE];
+
+	if ((file_size < sizeof(tag)) || (read(user_data, file_size - sizeof(tag), tag, sizeof(tag)) != sizeof(tag)) || (memcmp(tag, "TAG", 3) != 0)) {
+		return false;
+	}
+
+	if (info->title[0] == '\0') {
+		decode_text(info->title, &tag[MP3_INFO_ID3V1_TITLE_OFFSET], MP3_INFO_ID3V1_FIELD_LENGTH, TEXT_LATIN1);
+	}
+	if (info->artist[0] == '\0') {
+		decode_text(info->artist, &tag[MP3_INFO_ID3V1_ARTIST_OFFSET], MP3_INFO_ID3V1_FIELD_LENGTH, TEXT_LATIN1);
+	}
+	return true;
+}
+
+static bool is_frame_header(const uint8_t *data) {
+	return (data[0] == 0xFF) &&
+		   ((data[1] & 0xE0) == 0xE0) && // Sync
+		   (((data[1] >> 3) & 0x03) != 0x01) && // Version not reserved
+		   (((data[1] >> 1) & 0x03) == 0x01) && // Layer III
+		   (((data[2] >> 4) & 0x0F) != 0x00) && (((data[2] >> 4) & 0x0F) != 0x0F) && // Valid, not free format bitrate
+		   (((data[2] >> 2) & 0x03) != 0x03); // Sample rate not reserved
+}
+
+int mp3_info_parse(mp3_info_t *info, uint32_t file_size, mp3_info_read_t read, void *user_data) {
+	uint8_t buffer[MP3_INFO_SYNC_SEARCH_SIZE];
+
+	/* Sanity check */
+	if ((info == NULL) || (read == NULL)) {
+		return -EINVAL;
+	}
+
+	memset(info, 0, sizeof(mp3_info_t));
+
+	const uint32_t audio_start = parse_id3v2(info, read, user_data);
+	const uint32_t audio_end = parse_id3v1(info, file_size, read, user_data) ? (file_size - MP3_INFO_ID3V1_SIZE) : file_size;
+
+	/* Find the first frame */
+	const size_t bytes_read = read(user_data, audio_start, buffer, sizeof(buffer));
+	size_t pos = 0;
+	while (((pos + MP3_INFO_FRAME_HEADER_SIZE) <= bytes_read) && !is_frame_header(&buffer[pos])) {
+		pos++;
+	}
+	if ((pos + MP3_INFO_FRAME_HEADER_SIZE) > bytes_read) {
+		return -ENODATA;
+	}
+
+	const uint8_t *header = &buffer[pos];
+	const uint8_t version = (header[1] >> 3) & 0x03; // 3 - MPEG1, 2 - MPEG2, 0 - MPEG2.5
+	const bool is_mpeg1 = (version == 0x03);
+	const bool is_mono = ((header[3] >> 6) & 0x03) == 0x03;
+	const uint32_t bitrate = (is_mpeg1 ? bitrates_mpeg1 : bitrates_mpeg2)[(header[2] >> 4) & 0x0F];
+	const uint32_t samples_per_frame = is_mpeg1 ? 1152 : 576;
+
+	info->sample_rate = sample_rates_mpeg1[(header[2] >> 2) & 0x03] >> (is_mpeg1 ? 0 : (version == 0x02) ? 1 : 2);
+
+	/* VBR files have Xing (or Info) header after side info, or VBRI header at fixed offset */
+	const size_t side_info_size = is_mpeg1 ? (is_mono ? 17 : 32) : (is_mono ? 9 : 17);
+	const size_t xing_pos = pos + MP3_INFO_FRAME_HEADER_SIZE + side_info_size;
+	const size_t vbri_pos = pos + MP3_INFO_FRAME_HEADER_SIZE + MP3_INFO_VBRI_OFFSET;
+	uint32_t frames = 0;
+
+	if (((xing_pos + 12) <= bytes_read) && ((memcmp(&buffer[xing_pos], "Xing", 4) == 0) || (memcmp(&buffer[xing_pos], "Info", 4) == 0))) {
+		if (get_be32(&buffer[xing_pos + 4]) & MP3_INFO_XING_FRAMES_FLAG) {
+			frames = get_be32(&buffer[xing_pos + 8]);
+		}
+	}
+	else if (((vbri_pos + 18) <= bytes_read) && (memcmp(&buffer[vbri_pos], "VBRI", 4) == 0)) {
+		frames = get_be32(&buffer[vbri_pos + 14]);
+	}
+
+	if (frames > 0) {
+		info->duration = ((uint64_t)frames * samples_per_frame) / info->sample_rate;
+	}
+	else {
+		/* No frame count, assume constant bitrate */
+		const uint32_t first_frame = audio_start + pos;
+		const uint32_t audio_size = (audio_end > first_frame) ? (audio_end - first_frame) : 0;
+		info->duration = audio_size / ((bitrate * 1000) / 8);
+	}
+
+	return 0;
+}
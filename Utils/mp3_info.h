@@ -0,0 +1,31 @@
+/*
+ * mp3_info.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+
+#ifndef MP3_INFO_H_
+#define MP3_INFO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Longer tags are truncated */
+#define MP3_INFO_TAG_LENGTH 47
+
+typedef struct {
+	uint32_t sample_rate; // Hz
+	uint32_t duration; // Seconds
+	char title[MP3_INFO_TAG_LENGTH + 1]; // CP850, empty if not tagged
+	char artist[MP3_INFO_TAG_LENGTH + 1];
+} mp3_info_t;
+
+/* Reads up to size bytes at given offset of the file, returns number of bytes read */
+typedef size_t (*mp3_info_read_t)(void *user_data, uint32_t offset, void *buffer, size_t size);
+
+/* Gets stream parameters from the first frame header and Xing/VBRI header, if present, and
+ * title and artist from ID3v2 or ID3v1 tag. Touches only a few small parts of the file. */
+int mp3_info_parse(mp3_info_t *info, uint32_t file_size, mp3_info_read_t read, void *user_data);
+
+#endif /* MP3_INFO_H_ */
@@ -0,0 +1,291 @@
+/*
+ * playlist.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "playlist.h"
+#include "dir_cache.h"
+#include "filename.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+#define PLAYLIST_BOM_LENGTH 3
+
+typedef enum {
+	PLAYLIST_LINE_START, // Whitespace before the first character of a line
+	PLAYLIST_LINE_ENTRY,
+	PLAYLIST_LINE_SKIP // Comment or extended M3U directive
+} playlist_line_state_t;
+
+static char root[DIR_CACHE_PATH_LENGTH];
+
+static const uint8_t bom[PLAYLIST_BOM_LENGTH] = {0xEF, 0xBB, 0xBF};
+
+/* Single pass over the playlist, offsets of entries are written to index file in batches */
+static int build_index(playlist_t *playlist, uint8_t *chunk) {
+	uint32_t offsets[PLAYLIST_PARSE_CHUNK_SIZE / sizeof(uint32_t)];
+	size_t offsets_count = 0;
+	playlist_line_state_t state = PLAYLIST_LINE_START;
+	uint32_t offset = 0;
+	UINT bytes_read;
+	UINT bytes_written;
+
+	playlist->count = 0;
+
+	while (1) {
+		if (f_read(&playlist->file, chunk, PLAYLIST_PARSE_CHUNK_SIZE, &bytes_read) != FR_OK) {
+			return -EIO;
+		}
+
+		size_t pos = 0;
+
+		/* Byte order mark is not a part of the first entry */
+		if ((offset == 0) && (bytes_read >= PLAYLIST_BOM_LENGTH) && (memcmp(chunk, bom, PLAYLIST_BOM_LENGTH) == 0)) {
+			playlist->utf8 = true;
+			pos = PLAYLIST_BOM_LENGTH;
+		}
+
+		for (; pos < bytes_read; ++pos) {
+			const char chr = chunk[pos];
+
+			if ((chr == '\r') || (chr == '\n')) {
+				state = PLAYLIST_LINE_START;
+				continue;
+			}
+
+			if (state != PLAYLIST_LINE_START) {
+				continue;
+			}
+
+			if ((chr == ' ') || (chr == '\t')) {
+				continue;
+			}
+
+			if (chr == '#') {
+				state = PLAYLIST_LINE_SKIP;
+				continue;
+			}
+
+			state = PLAYLIST_LINE_ENTRY;
+			offsets[offsets_count++] = offset + pos;
+			playlist->count++;
+
+			if (offsets_count == (sizeof(offsets) / sizeof(offsets[0]))) {
+				if ((f_write(&playlist->index, offsets, sizeof(offsets), &bytes_written) != FR_OK) || (bytes_written != sizeof(offsets))) {
+					return -EIO;
+				}
+				offsets_count = 0;
+			}
+		}
+
+		offset += bytes_read;
+		if (bytes_read < PLAYLIST_PARSE_CHUNK_SIZE) {
+			break; // End of file
+		}
+	}
+
+	const UINT remaining_size = offsets_count * sizeof(uint32_t);
+	if ((f_write(&playlist->index, offsets, remaining_size, &bytes_written) != FR_OK) || (bytes_written != remaining_size)) {
+		return -EIO;
+	}
+
+	return (f_sync(&playlist->index) == FR_OK) ? 0 : -EIO;
+}
+
+/* Converts UTF-8 to code page of the file system in place, unrepresentable characters become '?' */
+static void decode_utf8(char *line) {
+	const uint8_t *src = (const uint8_t *)line;
+	char *dst = line;
+
+	while (*src != '\0') {
+		WCHAR chr;
+		size_t length;
+
+		if (src[0] < 0x80) {
+			chr = src[0];
+			length = 1;
+		}
+		else if (((src[0] & 0xE0) == 0xC0) && ((src[1] & 0xC0) == 0x80)) {
+			chr = ((src[0] & 0x1F) << 6) | (src[1] & 0x3F);
+			length = 2;
+		}
+		else if (((src[0] & 0xF0) == 0xE0) && ((src[1] & 0xC0) == 0x80) && ((src[2] & 0xC0) == 0x80)) {
+			chr = ((src[0] & 0x0F) << 12) | ((src[1] & 0x3F) << 6) | (src[2] & 0x3F);
+			length = 3;
+		}
+		else {
+			chr = 0; // Invalid sequence or outside of BMP
+			length = 1;
+			while (((src[length] & 0xC0) == 0x80) && (length < 4)) {
+				length++;
+			}
+		}
+
+		if (chr >= 0x80) {
+			chr = ff_convert(chr, 0);
+		}
+		*dst++ = ((chr == 0) || (chr > 0xFF)) ? '?' : (char)chr;
+		src += length;
+	}
+
+	*dst = '\0';
+}
+
+/* Appends entry to base path, resolving '.' and '..' segments. Never goes above root. */
+static int resolve_path(char *buffer, size_t size, const char *base, char *entry) {
+	const size_t root_length = strlen(root);
+	size_t length = strlen(base);
+
+	if (length >= size) {
+		return -ENAMETOOLONG;
+	}
+	memcpy(buffer, base, length + 1);
+
+	char *save_ptr;
+	for (char *segment = strtok_r(entry, "/\\", &save_ptr); segment != NULL; segment = strtok_r(NULL, "/\\", &save_ptr)) {
+		if (strcmp(segment, ".") == 0) {
+			continue;
+		}
+
+		if (strcmp(segment, "..") == 0) {
+			char *last_slash = strrchr(buffer, '/');
+			if ((last_slash != NULL) && ((size_t)(last_slash - buffer) >= root_length)) {
+				*last_slash = '\0';
+				length = last_slash - buffer;
+			}
+			continue;
+		}
+
+		const size_t segment_length = strlen(segment);
+		if ((length + 1 + segment_length) >= size) {
+			return -ENAMETOOLONG;
+		}
+		buffer[length++] = '/';
+		memcpy(&buffer[length], segment, segment_length + 1);
+		length += segment_length;
+	}
+
+	return 0;
+}
+
+void playlist_init(const char *root_path) {
+	strncpy(root, root_path, sizeof(root) - 1);
+}
+
+bool playlist_is_playlist(const char *name) {
+	return filename_has_extension(name, ".m3u") || filename_has_extension(name, ".m3u8");
+}
+
+int playlist_open(playlist_t *playlist, const char *dir_path, const char *name) {
+	char path[DIR_CACHE_PATH_LENGTH];
+
+	/* Sanity check */
+	if ((playlist == NULL) || (dir_path == NULL) || (name == NULL)) {
+		return -EINVAL;
+	}
+
+	memset(playlist, 0, sizeof(playlist_t));
+	playlist->utf8 = filename_has_extension(name, ".m3u8");
+
+	const size_t dir_path_length = strlen(dir_path);
+	const size_t path_length = dir_path_length + strlen(name) + 2; // Additional '/' and null-terminator
+	playlist->base_path = malloc(path_length);
+	if (playlist->base_path == NULL) {
+		return -ENOMEM;
+	}
+
+	/* Open the playlist, then cut its name off to get base path */
+	snprintf(playlist->base_path, path_length, "%s/%s", dir_path, name);
+	if (f_open(&playlist->file, playlist->base_path, FA_READ) != FR_OK) {
+		free(playlist->base_path);
+		return -EIO;
+	}
+	playlist->base_path[dir_path_length] = '\0';
+
+	if ((dir_cache_get_path(path, sizeof(path), PLAYLIST_INDEX_NAME) != 0) ||
+		(f_open(&playlist->index, path, FA_READ | FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)) {
+		f_close(&playlist->file);
+		free(playlist->base_path);
+		return -EIO;
+	}
+
+	uint8_t *chunk = malloc(PLAYLIST_PARSE_CHUNK_SIZE);
+	const int ret = (chunk != NULL) ? build_index(playlist, chunk) : -ENOMEM;
+	free(chunk);
+
+	if (ret != 0) {
+		playlist_close(playlist);
+		return ret;
+	}
+
+	/* Index written by the device doesn't mean the card was modified elsewhere */
+	dir_cache_sync_state();
+	return 0;
+}
+
+uint32_t playlist_get_count(const playlist_t *playlist) {
+	return (playlist != NULL) ? playlist->count : 0;
+}
+
+int playlist_get_path(playlist_t *playlist, uint32_t entry, char *buffer, size_t size) {
+	char line[PLAYLIST_LINE_LENGTH + 1];
+	uint32_t offset;
+	UINT bytes_read;
+
+	/* Sanity check */
+	if ((playlist == NULL) || (buffer == NULL) || (entry >= playlist->count)) {
+		return -EINVAL;
+	}
+
+	/* Offset from index, then the entry itself */
+	if ((f_lseek(&playlist->index, entry * sizeof(uint32_t)) != FR_OK) ||
+		(f_read(&playlist->index, &offset, sizeof(offset), &bytes_read) != FR_OK) || (bytes_read != sizeof(offset))) {
+		return -EIO;
+	}
+
+	if ((f_lseek(&playlist->file, offset) != FR_OK) ||
+		(f_read(&playlist->file, line, PLAYLIST_LINE_LENGTH, &bytes_read) != FR_OK)) {
+		return -EIO;
+	}
+	line[bytes_read] = '\0';
+
+	/* Cut off line ending and trailing whitespace */
+	line[strcspn(line, "\r\n")] = '\0';
+	size_t length = strlen(line);
+	while ((length > 0) && ((line[length - 1] == ' ') || (line[length - 1] == '\t'))) {
+		line[--length] = '\0';
+	}
+
+	/* Streams can't be played */
+	if (strstr(line, "://") != NULL) {
+		return -ENOENT;
+	}
+
+	if (playlist->utf8) {
+		decode_utf8(line);
+	}
+
+	/* Absolute entries are relative to the root of the card */
+	const bool is_absolute = (line[0] == '/') || (line[0] == '\\');
+	return resolve_path(buffer, size, is_absolute ? root : playlist->base_path, line);
+}
+
+void playlist_close(playlist_t *playlist) {
+	if (playlist == NULL) {
+		return;
+	}
+
+	if (playlist->base_path == NULL) {
+		return; // Not opened
+	}
+
+	f_close(&playlist->index);
+	f_close(&playlist->file);
+	free(playlist->base_path);
+	playlist->base_path = NULL;
+
+	dir_cache_sync_state();
+}
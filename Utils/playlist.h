@@ -0,0 +1,50 @@
+/*
+ * playlist.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+
+#ifndef PLAYLIST_H_
+#define PLAYLIST_H_
+
+#include "fatfs.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Name of the file in cache directory the index of opened playlist is kept in */
+#define PLAYLIST_INDEX_NAME "playlist.idx"
+
+/* Max length of a single entry, longer ones are truncated */
+#define PLAYLIST_LINE_LENGTH 256
+
+/* Size of buffer playlist is parsed with */
+#define PLAYLIST_PARSE_CHUNK_SIZE 512
+
+/* Opened M3U/M3U8 playlist. On opening it's parsed once, file offsets of all the entries are
+ * stored in index file on the card, so any entry is read with a single seek in the playlist,
+ * no matter how long it is, while only the two file objects are kept in RAM. */
+typedef struct {
+	FIL file;
+	FIL index; // Offsets of the entries, uint32_t each
+	uint32_t count;
+	bool utf8; // M3U8 or M3U starting with BOM
+	char *base_path; // Directory the playlist is in, relative entries are resolved against it
+} playlist_t;
+
+void playlist_init(const char *root_path);
+
+bool playlist_is_playlist(const char *name);
+
+/* Opens and indexes playlist of given name from given directory */
+int playlist_open(playlist_t *playlist, const char *dir_path, const char *name);
+
+uint32_t playlist_get_count(const playlist_t *playlist);
+
+/* Reads entry and resolves it to the path of the file it refers to */
+int playlist_get_path(playlist_t *playlist, uint32_t entry, char *buffer, size_t size);
+
+void playlist_close(playlist_t *playlist);
+
+#endif /* PLAYLIST_H_ */
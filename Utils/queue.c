@@ -0,0 +1,340 @@
+/*
+ * queue.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "queue.h"
+#include "dir.h"
+#include "dir_tree.h"
+#include "playlist.h"
+#include "shuffle.h"
+#include "filename.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+typedef struct {
+	queue_source_t source;
+	char *dir_path; // Directory being played from, for directory sources
+	dir_list_t *list; // Own listing, explorer can browse elsewhere meanwhile
+	shuffle_t shuffle;
+	playlist_t playlist;
+	dir_tree_t tree; // Already moved to the next track
+	library_track_info_t track_info;
+	uint32_t size; // Number of positions in the source
+	uint32_t position; // Position of the current track
+	uint32_t next_position;
+	bool has_next;
+	queue_track_t current;
+	queue_track_t next;
+} queue_ctx_t;
+
+static queue_ctx_t ctx;
+
+static int set_track(queue_track_t *track, const char *dir_path, const char *name, uint32_t size) {
+	const int length = snprintf(track->path, sizeof(track->path), "%s/%s", dir_path, name);
+	if ((length < 0) || ((size_t)length >= sizeof(track->path))) {
+		return -ENAMETOOLONG;
+	}
+
+	track->name = strrchr(track->path, '/') + 1;
+	track->size = size;
+	return 0;
+}
+
+static int resolve_dir_entry(size_t entry, queue_track_t *track) {
+	const dir_info_t *info = dir_get_info(ctx.list, entry);
+	if ((info == NULL) || (info->attrib & AM_DIR) || !filename_has_extension(info->name, ".mp3")) {
+		return -ENOENT;
+	}
+
+	return set_track(track, ctx.dir_path, info->name, info->size);
+}
+
+static int resolve_library_track(uint32_t index, queue_track_t *track) {
+	library_track_t library_track;
+	if ((library_get_track(index, &library_track) != 0) || (library_get_track_info(library_track, &ctx.track_info) != 0)) {
+		return -EIO;
+	}
+
+	const int ret = library_get_track_path(library_track, track->path, sizeof(track->path));
+	if (ret != 0) {
+		return ret;
+	}
+
+	track->name = strrchr(track->path, '/') + 1;
+	track->size = ctx.track_info.size;
+	return 0;
+}
+
+static int resolve_playlist_entry(uint32_t entry, queue_track_t *track) {
+	FILINFO fno;
+
+	const int ret = playlist_get_path(&ctx.playlist, entry, track->path, sizeof(track->path));
+	if (ret != 0) {
+		return ret;
+	}
+
+	/* Missing files are skipped */
+	if ((f_stat(track->path, &fno) != FR_OK) || (fno.fattrib & AM_DIR) || !filename_has_extension(track->path, ".mp3")) {
+		return -ENOENT;
+	}
+
+	track->name = strrchr(track->path, '/') + 1;
+	track->size = fno.fsize;
+	return 0;
+}
+
+static int resolve(uint32_t position, queue_track_t *track) {
+	switch (ctx.source) {
+		case QUEUE_DIR:
+			return resolve_dir_entry(position, track);
+
+		case QUEUE_SHUFFLE_DIR:
+			return resolve_dir_entry(shuffle_get(&ctx.shuffle, position), track);
+
+		case QUEUE_SHUFFLE_LIBRARY:
+			return resolve_library_track(shuffle_get(&ctx.shuffle, position), track);
+
+		case QUEUE_PLAYLIST:
+			return resolve_playlist_entry(position, track);
+
+		default:
+			return -EINVAL;
+	}
+}
+
+static uint32_t step(uint32_t position, bool forward) {
+	if (forward) {
+		return ((position + 1) == ctx.size) ? 0 : (position + 1);
+	}
+	return (position == 0) ? (ctx.size - 1) : (position - 1);
+}
+
+/* Finds the first playable track starting from given position. Without wraparound stops at the end, so that every track is played once. */
+static int find(uint32_t position, bool forward, bool wrap, uint32_t *found, queue_track_t *track) {
+	for (uint32_t i = 0; (i < ctx.size) && (position < ctx.size); ++i) {
+		if (resolve(position, track) == 0) {
+			*found = position;
+			return 0;
+		}
+
+		if (!wrap && (position == (forward ? (ctx.size - 1) : 0))) {
+			break;
+		}
+		position = step(position, forward);
+	}
+
+	return -ENOENT;
+}
+
+static void copy_track(queue_track_t *dst, const queue_track_t *src) {
+	strcpy(dst->path, src->path);
+	dst->name = &dst->path[src->name - src->path];
+	dst->size = src->size;
+}
+
+/* Looks ahead for the track to be played after the current one */
+static void update_next(void) {
+	if (ctx.source == QUEUE_TREE) {
+		ctx.has_next = (dir_tree_next(&ctx.tree) == 0);
+		if (ctx.has_next) {
+			strcpy(ctx.next.path, ctx.tree.path);
+			ctx.next.name = &ctx.next.path[ctx.tree.name - ctx.tree.path];
+			ctx.next.size = ctx.tree.size;
+		}
+		return;
+	}
+
+	ctx.has_next = ((ctx.position + 1) < ctx.size) && (find(ctx.position + 1, true, false, &ctx.next_position, &ctx.next) == 0);
+}
+
+static int start(uint32_t position) {
+	if (find(position, true, false, &ctx.position, &ctx.current) != 0) {
+		queue_clear();
+		return -ENOENT;
+	}
+
+	update_next();
+	return 0;
+}
+
+static int start_dir_source(queue_source_t source, const char *dir_path) {
+	queue_clear();
+
+	ctx.dir_path = strdup(dir_path);
+	if (ctx.dir_path == NULL) {
+		return -ENOMEM;
+	}
+
+	ctx.source = source;
+	ctx.list = dir_list_path(dir_path);
+	if (ctx.list == NULL) {
+		queue_clear();
+		return -EIO;
+	}
+
+	ctx.size = dir_list_size(ctx.list);
+	return 0;
+}
+
+int queue_play_dir(const char *dir_path, size_t entry) {
+	/* Sanity check */
+	if (dir_path == NULL) {
+		return -EINVAL;
+	}
+
+	const int ret = start_dir_source(QUEUE_DIR, dir_path);
+	if (ret != 0) {
+		return ret;
+	}
+
+	return start(entry);
+}
+
+int queue_shuffle_dir(const char *dir_path, uint32_t seed) {
+	/* Sanity check */
+	if (dir_path == NULL) {
+		return -EINVAL;
+	}
+
+	const int ret = start_dir_source(QUEUE_SHUFFLE_DIR, dir_path);
+	if (ret != 0) {
+		return ret;
+	}
+
+	shuffle_init(&ctx.shuffle, ctx.size, seed);
+	return start(0);
+}
+
+int queue_shuffle_library(uint32_t seed) {
+	if (library_get_state() != LIBRARY_READY) {
+		return -EBUSY;
+	}
+
+	queue_clear();
+	ctx.source = QUEUE_SHUFFLE_LIBRARY;
+	ctx.size = library_get_track_count();
+	shuffle_init(&ctx.shuffle, ctx.size, seed);
+
+	return start(0);
+}
+
+int queue_play_tree(const char *dir_path, const char *name) {
+	char path[DIR_TREE_PATH_LENGTH];
+
+	/* Sanity check */
+	if ((dir_path == NULL) || (name == NULL)) {
+		return -EINVAL;
+	}
+
+	queue_clear();
+
+	const int length = snprintf(path, sizeof(path), "%s/%s", dir_path, name);
+	if ((length < 0) || ((size_t)length >= sizeof(path))) {
+		return -ENAMETOOLONG;
+	}
+
+	int ret = dir_tree_init(&ctx.tree, path);
+	if (ret != 0) {
+		return ret;
+	}
+	ctx.source = QUEUE_TREE;
+
+	/* No MP3 files inside */
+	ret = dir_tree_next(&ctx.tree);
+	if (ret != 0) {
+		queue_clear();
+		return ret;
+	}
+
+	strcpy(ctx.current.path, ctx.tree.path);
+	ctx.current.name = &ctx.current.path[ctx.tree.name - ctx.tree.path];
+	ctx.current.size = ctx.tree.size;
+
+	update_next();
+	return 0;
+}
+
+int queue_play_playlist(const char *dir_path, const char *name) {
+	queue_clear();
+
+	const int ret = playlist_open(&ctx.playlist, dir_path, name);
+	if (ret != 0) {
+		return ret;
+	}
+
+	ctx.source = QUEUE_PLAYLIST;
+	ctx.size = playlist_get_count(&ctx.playlist);
+	return start(0);
+}
+
+queue_source_t queue_get_source(void) {
+	return ctx.source;
+}
+
+const queue_track_t *queue_get_current(void) {
+	return (ctx.source != QUEUE_EMPTY) ? &ctx.current : NULL;
+}
+
+const queue_track_t *queue_get_next(void) {
+	return ((ctx.source != QUEUE_EMPTY) && ctx.has_next) ? &ctx.next : NULL;
+}
+
+int queue_next(void) {
+	if ((ctx.source == QUEUE_EMPTY) || !ctx.has_next) {
+		return -ENOENT;
+	}
+
+	copy_track(&ctx.current, &ctx.next);
+	ctx.position = ctx.next_position;
+
+	update_next();
+	return 0;
+}
+
+int queue_skip(bool forward) {
+	switch (ctx.source) {
+		case QUEUE_EMPTY:
+			return -ENOENT;
+
+		case QUEUE_TREE:
+			/* Walk goes only forward, previous restarts the current track */
+			return forward ? queue_next() : 0;
+
+		default:
+			/* Resolved in place of the next one, it's looked up again anyway */
+			if (find(step(ctx.position, forward), forward, true, &ctx.position, &ctx.next) != 0) {
+				return -ENOENT;
+			}
+			copy_track(&ctx.current, &ctx.next);
+			update_next();
+			return 0;
+	}
+}
+
+void queue_clear(void) {
+	switch (ctx.source) {
+		case QUEUE_TREE:
+			dir_tree_close(&ctx.tree);
+			break;
+
+		case QUEUE_PLAYLIST:
+			playlist_close(&ctx.playlist);
+			break;
+
+		default:
+			break;
+	}
+
+	dir_list_free(ctx.list);
+	ctx.list = NULL;
+	free(ctx.dir_path);
+	ctx.dir_path = NULL;
+
+	ctx.source = QUEUE_EMPTY;
+	ctx.size = 0;
+	ctx.has_next = false;
+}
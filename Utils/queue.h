@@ -0,0 +1,58 @@
+/*
+ * queue.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+
+#ifndef QUEUE_H_
+#define QUEUE_H_
+
+#include "fatfs.h"
+#include "library.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Enough for any track from library, tree or playlist */
+#define QUEUE_PATH_LENGTH (LIBRARY_PATH_LENGTH + _MAX_LFN + 1)
+
+typedef enum {
+	QUEUE_EMPTY,
+	QUEUE_DIR, // Files of a directory, in listed order
+	QUEUE_SHUFFLE_DIR, // Files of a directory, in random order
+	QUEUE_SHUFFLE_LIBRARY, // All the tracks from library, in random order
+	QUEUE_TREE, // All the files beneath a directory, depth-first
+	QUEUE_PLAYLIST // Entries of M3U/M3U8 playlist
+} queue_source_t;
+
+typedef struct {
+	uint32_t size; // Bytes
+	const char *name; // Points into path
+	char path[QUEUE_PATH_LENGTH];
+} queue_track_t;
+
+/* Queue of tracks to be played, independent of the directory being browsed. Tracks are referenced by their
+ * position in the source - listing, shuffled order or playlist - and resolved to paths only for the current
+ * and the next one, the latter to be opened by the player ahead of time. Entries that are not MP3 files are
+ * skipped. Only one queue exists, starting a new one replaces the previous. */
+int queue_play_dir(const char *dir_path, size_t entry);
+int queue_shuffle_dir(const char *dir_path, uint32_t seed);
+int queue_shuffle_library(uint32_t seed);
+int queue_play_tree(const char *dir_path, const char *name);
+int queue_play_playlist(const char *dir_path, const char *name);
+
+queue_source_t queue_get_source(void);
+
+/* Return NULL if queue is empty or there's no next track */
+const queue_track_t *queue_get_current(void);
+const queue_track_t *queue_get_next(void);
+
+/* Moves on to the next track, returns -ENOENT at the end of the queue */
+int queue_next(void);
+
+/* Skips to previous or next track, wrapping around. Going back restarts the current track of tree walk. */
+int queue_skip(bool forward);
+
+void queue_clear(void);
+
+#endif /* QUEUE_H_ */
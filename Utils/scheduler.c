@@ -0,0 +1,164 @@
+/*
+ * scheduler.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "scheduler.h"
+#include <errno.h>
+#include <string.h>
+
+#define SCHEDULER_NO_TASK -1
+
+typedef struct {
+	const scheduler_task_t *task;
+	int id;
+	uint32_t idle_tick; // Last time the event was found not pending
+	scheduler_stats_t stats;
+} scheduler_entry_t;
+
+typedef struct {
+	scheduler_entry_t entries[SCHEDULER_MAX_TASKS]; // Sorted by priority
+	size_t entries_num;
+	uint32_t (*get_ticks)(void);
+	uint32_t ticks_per_us;
+	int current; // Index of the entry being run
+	uint32_t start_tick; // When it was started
+} scheduler_ctx_t;
+
+/* Code run outside the scheduler, e.g. on host, may ask whether to yield before it was initialized */
+static scheduler_ctx_t ctx = {
+	.current = SCHEDULER_NO_TASK
+};
+
+static uint32_t elapsed_us(uint32_t since) {
+	return (ctx.get_ticks() - since) / ctx.ticks_per_us;
+}
+
+/* Checks the event, remembering when it was last known not to be pending */
+static bool is_ready(scheduler_entry_t *entry) {
+	if (entry->task->ready == NULL) {
+		return true;
+	}
+
+	if (!entry->task->ready()) {
+		entry->idle_tick = ctx.get_ticks();
+		return false;
+	}
+	return true;
+}
+
+static void run_entry(size_t index) {
+	scheduler_entry_t *entry = &ctx.entries[index];
+	scheduler_stats_t *stats = &entry->stats;
+	const scheduler_task_t *task = entry->task;
+
+	ctx.current = index;
+	ctx.start_tick = ctx.get_ticks();
+
+	/* Event happened somewhere after the last check that found it not pending */
+	if (task->ready != NULL) {
+		const uint32_t latency = (ctx.start_tick - entry->idle_tick) / ctx.ticks_per_us;
+		if (latency > stats->worst_latency) {
+			stats->worst_latency = latency;
+		}
+		if ((task->deadline > 0) && (latency > task->deadline)) {
+			stats->deadline_misses++;
+		}
+	}
+
+	task->run();
+
+	const uint32_t time = elapsed_us(ctx.start_tick);
+	stats->runs++;
+	if (time > stats->worst_time) {
+		stats->worst_time = time;
+	}
+	if (time > task->budget) {
+		stats->overruns++;
+	}
+
+	ctx.current = SCHEDULER_NO_TASK;
+}
+
+void scheduler_init(uint32_t (*get_ticks)(void), uint32_t ticks_per_us) {
+	memset(&ctx, 0, sizeof(scheduler_ctx_t));
+	ctx.get_ticks = get_ticks;
+	ctx.ticks_per_us = (ticks_per_us > 0) ? ticks_per_us : 1;
+	ctx.current = SCHEDULER_NO_TASK;
+}
+
+int scheduler_add(const scheduler_task_t *task) {
+	/* Sanity check */
+	if ((task == NULL) || (task->run == NULL) || (ctx.get_ticks == NULL)) {
+		return -EINVAL;
+	}
+
+	if (ctx.entries_num == SCHEDULER_MAX_TASKS) {
+		return -ENOSPC;
+	}
+
+	/* Insert after all the tasks of the same or higher priority */
+	size_t index = ctx.entries_num;
+	while ((index > 0) && (ctx.entries[index - 1].task->priority > task->priority)) {
+		ctx.entries[index] = ctx.entries[index - 1];
+		index--;
+	}
+
+	scheduler_entry_t *entry = &ctx.entries[index];
+	memset(entry, 0, sizeof(scheduler_entry_t));
+	entry->task = task;
+	entry->id = ctx.entries_num;
+	entry->idle_tick = ctx.get_ticks();
+
+	ctx.entries_num++;
+	return entry->id;
+}
+
+void scheduler_run(void) {
+	for (size_t i = 0; i < ctx.entries_num; ++i) {
+		/* Higher priority events are handled first, whenever they happen */
+		for (size_t j = 0; (j < i) && (ctx.entries[j].task->priority < ctx.entries[i].task->priority); ++j) {
+			if ((ctx.entries[j].task->ready != NULL) && is_ready(&ctx.entries[j])) {
+				run_entry(j);
+			}
+		}
+
+		if (is_ready(&ctx.entries[i])) {
+			run_entry(i);
+		}
+	}
+}
+
+bool scheduler_should_yield(void) {
+	if ((ctx.get_ticks == NULL) || (ctx.current == SCHEDULER_NO_TASK)) {
+		return false;
+	}
+
+	const scheduler_entry_t *current = &ctx.entries[ctx.current];
+	if (elapsed_us(ctx.start_tick) >= current->task->budget) {
+		return true;
+	}
+
+	for (size_t i = 0; (i < ctx.entries_num) && (ctx.entries[i].task->priority < current->task->priority); ++i) {
+		if ((ctx.entries[i].task->ready != NULL) && is_ready(&ctx.entries[i])) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int scheduler_get_stats(int task_id, scheduler_stats_t *stats) {
+	/* Sanity check */
+	if (stats == NULL) {
+		return -EINVAL;
+	}
+
+	for (size_t i = 0; i < ctx.entries_num; ++i) {
+		if (ctx.entries[i].id == task_id) {
+			*stats = ctx.entries[i].stats;
+			return 0;
+		}
+	}
+	return -ENOENT;
+}
@@ -0,0 +1,56 @@
+/*
+ * scheduler.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCHEDULER_MAX_TASKS 8
+
+typedef enum {
+	SCHEDULER_PRIORITY_AUDIO, // Output buffer refill, nothing may delay it
+	SCHEDULER_PRIORITY_IO, // Card transfers
+	SCHEDULER_PRIORITY_UI,
+	SCHEDULER_PRIORITY_BACKGROUND // Indexing, runs only in what's left
+} scheduler_priority_t;
+
+typedef struct {
+	const char *name;
+	void (*run)(void);
+	bool (*ready)(void); // Event the task waits for, checked before each lower priority task; NULL to run once per pass
+	scheduler_priority_t priority;
+	uint32_t budget; // us, run taking longer is an overrun, looping tasks should yield once it's used up
+	uint32_t deadline; // us, longest allowed time from event to run, 0 if none
+} scheduler_task_t;
+
+typedef struct {
+	uint32_t runs;
+	uint32_t overruns; // Runs exceeding the budget
+	uint32_t worst_time; // us
+	uint32_t deadline_misses; // Runs started later than the deadline
+	uint32_t worst_latency; // us, upper bound of time from event to run
+} scheduler_stats_t;
+
+/* Time is measured with free running counter of given frequency, e.g. CPU cycle counter */
+void scheduler_init(uint32_t (*get_ticks)(void), uint32_t ticks_per_us);
+
+/* Adds task, tasks of the same priority are run in the order they were added. Returns task ID. */
+int scheduler_add(const scheduler_task_t *task);
+
+/* Runs every task once in priority order, with pending events of higher priority tasks handled
+ * before each of them */
+void scheduler_run(void);
+
+/* Returns true if task being run has used up its budget or a higher priority one is waiting */
+bool scheduler_should_yield(void);
+
+int scheduler_get_stats(int task_id, scheduler_stats_t *stats);
+
+#endif /* SCHEDULER_H_ */
@@ -0,0 +1,65 @@
+/*
+ * shuffle.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "shuffle.h"
+#include <stddef.h>
+
+/* Finalizer of MurmurHash3, every input bit affects every output bit */
+static uint32_t mix(uint32_t x) {
+	x ^= x >> 16;
+	x *= 0x85EBCA6B;
+	x ^= x >> 13;
+	x *= 0xC2B2AE35;
+	x ^= x >> 16;
+	return x;
+}
+
+static uint32_t permute(const shuffle_t *shuffle, uint32_t x) {
+	const uint32_t mask = (1UL << shuffle->half_bits) - 1;
+	uint32_t left = x >> shuffle->half_bits;
+	uint32_t right = x & mask;
+
+	for (size_t i = 0; i < SHUFFLE_ROUNDS; ++i) {
+		const uint32_t tmp = right;
+		right = left ^ (mix(right ^ shuffle->keys[i]) & mask);
+		left = tmp;
+	}
+
+	return (left << shuffle->half_bits) | right;
+}
+
+void shuffle_init(shuffle_t *shuffle, uint32_t size, uint32_t seed) {
+	if (shuffle == NULL) {
+		return;
+	}
+
+	shuffle->size = size;
+
+	/* Domain of 2^(2 * half_bits) is less than 4 * size, so on average less than 4 rounds of walking are needed */
+	shuffle->half_bits = 1;
+	while ((shuffle->half_bits < 16) && ((1UL << (2 * shuffle->half_bits)) < size)) {
+		shuffle->half_bits++;
+	}
+
+	for (size_t i = 0; i < SHUFFLE_ROUNDS; ++i) {
+		seed = mix(seed + 0x9E3779B9); // Golden ratio increment, so that zero seed works as well
+		shuffle->keys[i] = seed;
+	}
+}
+
+uint32_t shuffle_get(const shuffle_t *shuffle, uint32_t position) {
+	/* Sanity check */
+	if ((shuffle == NULL) || (position >= shuffle->size)) {
+		return position;
+	}
+
+	uint32_t index = position;
+	do {
+		index = permute(shuffle, index);
+	} while (index >= shuffle->size);
+
+	return index;
+}
@@ -0,0 +1,31 @@
+/*
+ * shuffle.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+
+#ifndef SHUFFLE_H_
+#define SHUFFLE_H_
+
+#include <stdint.h>
+
+#define SHUFFLE_ROUNDS 4
+
+/* Random permutation of 0..size-1 computed on the fly. Position is mapped to index by a Feistel
+ * network over the smallest even power of two covering size, values outside the range are fed
+ * through it again until they fall inside (cycle walking). Being a bijection, it never repeats
+ * an index and needs no table, whatever the size. */
+typedef struct {
+	uint32_t size;
+	uint32_t half_bits; // Width of each half of the network input
+	uint32_t keys[SHUFFLE_ROUNDS];
+} shuffle_t;
+
+/* Each seed gives a different order */
+void shuffle_init(shuffle_t *shuffle, uint32_t size, uint32_t seed);
+
+/* Returns index to be played at given position, position has to be less than size */
+uint32_t shuffle_get(const shuffle_t *shuffle, uint32_t position);
+
+#endif /* SHUFFLE_H_ */
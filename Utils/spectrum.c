@@ -0,0 +1,189 @@
+/*
+ * spectrum.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "spectrum.h"
+#include <stdbool.h>
+
+/* Real input of FFT_SIZE samples is transformed as complex one of half the size, even samples being real
+ * and odd ones imaginary parts, then split into the spectrum of the real signal */
+#define SPECTRUM_COMPLEX_SIZE (SPECTRUM_FFT_SIZE / 2)
+#define SPECTRUM_COMPLEX_STAGES 7 // log2(SPECTRUM_COMPLEX_SIZE)
+
+#define SPECTRUM_SINE_QUARTER (SPECTRUM_FFT_SIZE / 4)
+#define SPECTRUM_Q15_SHIFT 15
+
+/* log2 of band power giving level 1, full scale sine gives about 2^42 */
+#define SPECTRUM_LEVEL_FLOOR 26
+
+typedef struct {
+	int32_t re[SPECTRUM_COMPLEX_SIZE];
+	int32_t im[SPECTRUM_COMPLEX_SIZE];
+} spectrum_ctx_t;
+
+static spectrum_ctx_t ctx;
+
+/* Quarter of sine period in Q15, sin(2 * pi * n / SPECTRUM_FFT_SIZE) for n from 0 to SPECTRUM_FFT_SIZE / 4 */
+static const int16_t sine_quarter[SPECTRUM_SINE_QUARTER + 1] = {
+	0, 804, 1608, 2410, 3212, 4011, 4808, 5602, 6393, 7179, 7962, 8739, 9512, 10278, 11039, 11793,
+	12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530, 18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+	23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790, 27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+	30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971, 32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+	32767
+};
+
+/* First bin of each band and end of the last one, log-spaced but at least one bin wide. Bin 0 (DC) is skipped. */
+static const uint8_t band_edges[SPECTRUM_BANDS + 1] = {
+	1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 14, 18, 23, 30, 38, 49, 62, 79, 100, 128
+};
+
+static int32_t sine(size_t index) {
+	index %= SPECTRUM_FFT_SIZE;
+
+	if (index <= SPECTRUM_SINE_QUARTER) {
+		return sine_quarter[index];
+	}
+	if (index <= (2 * SPECTRUM_SINE_QUARTER)) {
+		return sine_quarter[2 * SPECTRUM_SINE_QUARTER - index];
+	}
+	if (index <= (3 * SPECTRUM_SINE_QUARTER)) {
+		return -sine_quarter[index - 2 * SPECTRUM_SINE_QUARTER];
+	}
+	return -sine_quarter[SPECTRUM_FFT_SIZE - index];
+}
+
+static int32_t cosine(size_t index) {
+	return sine(index + SPECTRUM_SINE_QUARTER);
+}
+
+static int32_t multiply_q15(int32_t value, int32_t factor) {
+	return ((int64_t)value * factor) >> SPECTRUM_Q15_SHIFT;
+}
+
+static size_t reverse_bits(size_t value) {
+	size_t reversed = 0;
+
+	for (size_t i = 0; i < SPECTRUM_COMPLEX_STAGES; ++i) {
+		reversed = (reversed << 1) | (value & 1);
+		value >>= 1;
+	}
+	return reversed;
+}
+
+/* Mixes stereo frames down to mono, averaging DECIMATION frames per sample, applies Hann window
+ * and stores the result in bit-reversed order, ready for the FFT */
+static void load_input(const int16_t *frames, size_t frames_num, size_t position) {
+	for (size_t n = 0; n < SPECTRUM_FFT_SIZE; ++n) {
+		int32_t sum = 0;
+
+		for (size_t i = 0; i < SPECTRUM_DECIMATION; ++i) {
+			sum += frames[2 * position] + frames[2 * position + 1];
+			if (++position == frames_num) {
+				position = 0;
+			}
+		}
+
+		const int32_t sample = sum / (2 * SPECTRUM_DECIMATION);
+		const int32_t window = ((1 << SPECTRUM_Q15_SHIFT) - cosine(n)) / 2;
+		const int32_t value = multiply_q15(sample, window);
+
+		const size_t index = reverse_bits(n / 2);
+		if ((n % 2) == 0) {
+			ctx.re[index] = value;
+		}
+		else {
+			ctx.im[index] = value;
+		}
+	}
+}
+
+/* In-place radix-2 decimation in time, values grow up to SPECTRUM_COMPLEX_SIZE times, so 16-bit
+ * input never overflows */
+static void transform(void) {
+	for (size_t span = 1; span < SPECTRUM_COMPLEX_SIZE; span *= 2) {
+		const size_t twiddle_step = SPECTRUM_FFT_SIZE / (2 * span);
+
+		for (size_t j = 0; j < span; ++j) {
+			const int32_t w_re = cosine(j * twiddle_step);
+			const int32_t w_im = -sine(j * twiddle_step);
+
+			for (size_t a = j; a < SPECTRUM_COMPLEX_SIZE; a += 2 * span) {
+				const size_t b = a + span;
+				const int32_t t_re = multiply_q15(ctx.re[b], w_re) - multiply_q15(ctx.im[b], w_im);
+				const int32_t t_im = multiply_q15(ctx.re[b], w_im) + multiply_q15(ctx.im[b], w_re);
+
+				ctx.re[b] = ctx.re[a] - t_re;
+				ctx.im[b] = ctx.im[a] - t_im;
+				ctx.re[a] += t_re;
+				ctx.im[a] += t_im;
+			}
+		}
+	}
+}
+
+/* Power of bin k of the real signal, recovered from bins k and N-k of the complex transform */
+static uint64_t bin_power(size_t k) {
+	const size_t k_mirror = (SPECTRUM_COMPLEX_SIZE - k) % SPECTRUM_COMPLEX_SIZE;
+	const int32_t a_re = ctx.re[k];
+	const int32_t a_im = ctx.im[k];
+	const int32_t b_re = ctx.re[k_mirror];
+	const int32_t b_im = -ctx.im[k_mirror];
+
+	/* Spectra of even and odd samples */
+	const int32_t even_re = (a_re + b_re) / 2;
+	const int32_t even_im = (a_im + b_im) / 2;
+	const int32_t odd_re = (a_im - b_im) / 2;
+	const int32_t odd_im = (b_re - a_re) / 2;
+
+	const int32_t w_re = cosine(k);
+	const int32_t w_im = -sine(k);
+	const int64_t re = even_re + multiply_q15(odd_re, w_re) - multiply_q15(odd_im, w_im);
+	const int64_t im = even_im + multiply_q15(odd_re, w_im) + multiply_q15(odd_im, w_re);
+
+	return (uint64_t)(re * re + im * im);
+}
+
+static uint8_t power_to_level(uint64_t power) {
+	if (power == 0) {
+		return 0;
+	}
+
+	const int32_t level = (63 - __builtin_clzll(power)) - SPECTRUM_LEVEL_FLOOR;
+	if (level < 0) {
+		return 0;
+	}
+	return (level > SPECTRUM_MAX_LEVEL) ? SPECTRUM_MAX_LEVEL : level;
+}
+
+void spectrum_update(uint8_t *levels, const int16_t *frames, size_t frames_num, size_t position) {
+	/* Sanity check */
+	if (levels == NULL) {
+		return;
+	}
+
+	const bool analyze = (frames != NULL) && (frames_num >= SPECTRUM_INPUT_FRAMES) && (position < frames_num);
+	if (analyze) {
+		load_input(frames, frames_num, position);
+		transform();
+	}
+
+	for (size_t band = 0; band < SPECTRUM_BANDS; ++band) {
+		uint8_t level = 0;
+
+		if (analyze) {
+			uint64_t power = 0;
+			for (size_t k = band_edges[band]; k < band_edges[band + 1]; ++k) {
+				power += bin_power(k);
+			}
+			level = power_to_level(power);
+		}
+
+		/* Rise at once, fall slowly */
+		if (level + 1 < levels[band]) {
+			level = levels[band] - 1;
+		}
+		levels[band] = level;
+	}
+}
@@ -0,0 +1,26 @@
+/*
+ * spectrum.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+
+#ifndef SPECTRUM_H_
+#define SPECTRUM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SPECTRUM_FFT_SIZE 256
+#define SPECTRUM_DECIMATION 2 // Stereo frames mixed into a single sample, halves the band analyzed too
+#define SPECTRUM_INPUT_FRAMES (SPECTRUM_FFT_SIZE * SPECTRUM_DECIMATION)
+
+#define SPECTRUM_BANDS 20
+#define SPECTRUM_MAX_LEVEL 16 // 3dB per level
+
+/* Updates levels of SPECTRUM_BANDS log-spaced bands with spectrum of SPECTRUM_INPUT_FRAMES stereo frames,
+ * read from ring buffer of frames_num frames starting at given position. Levels fall by at most one
+ * per update, so that bars don't flicker; if frames is NULL they only fall. */
+void spectrum_update(uint8_t *levels, const int16_t *frames, size_t frames_num, size_t position);
+
+#endif /* SPECTRUM_H_ */
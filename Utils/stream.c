@@ -0,0 +1,168 @@
+/*
+ * stream.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+#include "stream.h"
+#include <string.h>
+#include <errno.h>
+
+static size_t min(size_t a, size_t b) {
+	return (a < b) ? a : b;
+}
+
+static int refill(stream_t *stream) {
+	UINT bytes_read;
+
+	/* File pointer always sits at the end of the buffered data, so next chunk starts right there */
+	stream->buffer_offset += stream->buffer_fill;
+	stream->buffer_pos -= stream->buffer_fill; // Keeps pending skip after seek, zero otherwise
+	stream->buffer_fill = 0;
+
+	const FRESULT ret = f_read(&stream->file, stream->buffer, stream->chunk_size, &bytes_read);
+	if (ret != FR_OK) {
+		return -EIO;
+	}
+
+	stream->buffer_fill = bytes_read;
+	return 0;
+}
+
+static void reset(stream_t *stream) {
+	/* Cluster is the largest unit FatFs can fetch with one disk read, don't exceed buffer though */
+	const size_t cluster_size = stream->file.obj.fs->csize * _MIN_SS;
+	stream->chunk_size = min(cluster_size, STREAM_BUFFER_SIZE);
+
+	stream->buffer_fill = 0;
+	stream->buffer_pos = 0;
+	stream->buffer_offset = 0;
+}
+
+int stream_open(stream_t *stream, const char *path) {
+	/* Sanity check */
+	if ((stream == NULL) || (path == NULL)) {
+		return -EINVAL;
+	}
+
+	const FRESULT ret = f_open(&stream->file, path, FA_READ);
+	if (ret != FR_OK) {
+		return -EIO;
+	}
+
+	reset(stream);
+	return 0;
+}
+
+int stream_attach(stream_t *stream, const FIL *file) {
+	/* Sanity check */
+	if ((stream == NULL) || (file == NULL)) {
+		return -EINVAL;
+	}
+
+	/* File has to be at its beginning, that's where buffering starts */
+	if (f_tell(file) != 0) {
+		return -EINVAL;
+	}
+
+	stream->file = *file;
+	reset(stream);
+	return 0;
+}
+
+size_t stream_read(stream_t *stream, void *buffer, size_t size) {
+	uint8_t *dst = buffer;
+	size_t bytes_copied = 0;
+
+	/* Sanity check */
+	if ((stream == NULL) || (buffer == NULL)) {
+		return 0;
+	}
+
+	while (size > 0) {
+		/* Buffer drained and request spans whole chunks - read them straight into destination */
+		if ((stream->buffer_pos == stream->buffer_fill) && (size >= stream->chunk_size)) {
+			UINT bytes_read;
+			const size_t direct_size = size - (size % stream->chunk_size);
+
+			stream->buffer_offset += stream->buffer_fill;
+			stream->buffer_pos = 0;
+			stream->buffer_fill = 0;
+
+			const FRESULT ret = f_read(&stream->file, dst, direct_size, &bytes_read);
+			stream->buffer_offset += bytes_read;
+			bytes_copied += bytes_read;
+			if ((ret != FR_OK) || (bytes_read < direct_size)) {
+				break;
+			}
+
+			dst += bytes_read;
+			size -= bytes_read;
+			continue;
+		}
+
+		/* Fetch next chunk if nothing left in buffer */
+		if (stream->buffer_pos >= stream->buffer_fill) {
+			if ((refill(stream) != 0) || (stream->buffer_pos >= stream->buffer_fill)) {
+				break; // Error or end of file
+			}
+		}
+
+		const size_t chunk = min(size, stream->buffer_fill - stream->buffer_pos);
+		memcpy(dst, &stream->buffer[stream->buffer_pos], chunk);
+
+		stream->buffer_pos += chunk;
+		bytes_copied += chunk;
+		dst += chunk;
+		size -= chunk;
+	}
+
+	return bytes_copied;
+}
+
+int stream_seek(stream_t *stream, FSIZE_t offset) {
+	/* Sanity check */
+	if (stream == NULL) {
+		return -EINVAL;
+	}
+
+	/* Don't seek past the end of file */
+	if (offset > f_size(&stream->file)) {
+		offset = f_size(&stream->file);
+	}
+
+	/* Target already buffered */
+	if ((offset >= stream->buffer_offset) && (offset <= (stream->buffer_offset + stream->buffer_fill))) {
+		stream->buffer_pos = offset - stream->buffer_offset;
+		return 0;
+	}
+
+	/* Move to the chunk containing target, the rest will be skipped on next refill */
+	const FSIZE_t aligned_offset = offset - (offset % stream->chunk_size);
+	const FRESULT ret = f_lseek(&stream->file, aligned_offset);
+	if (ret != FR_OK) {
+		return -EIO;
+	}
+
+	stream->buffer_offset = aligned_offset;
+	stream->buffer_fill = 0;
+	stream->buffer_pos = offset - aligned_offset;
+
+	return 0;
+}
+
+FSIZE_t stream_tell(const stream_t *stream) {
+	return stream->buffer_offset + stream->buffer_pos;
+}
+
+FSIZE_t stream_size(const stream_t *stream) {
+	return f_size(&stream->file);
+}
+
+void stream_close(stream_t *stream) {
+	if (stream == NULL) {
+		return;
+	}
+
+	f_close(&stream->file);
+}
@@ -0,0 +1,44 @@
+/*
+ * stream.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: lefucjusz
+ */
+
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include "fatfs.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Size of read-ahead buffer, has to be a power of two and a multiple of sector size */
+#define STREAM_BUFFER_SIZE 8192 // 16 sectors
+
+/* Buffered, sector-aligned reader on top of FatFs file. Every refill starts at
+ * a chunk-aligned offset and covers whole sectors within a single cluster, so
+ * that FatFs bypasses its per-file sector buffer and the disk driver gets one
+ * multi-sector read per refill instead of a series of single-sector ones. */
+typedef struct {
+	FIL file;
+	uint8_t buffer[STREAM_BUFFER_SIZE] __attribute__((aligned(4)));
+	size_t chunk_size; // Bytes fetched per refill - cluster size capped to buffer size
+	size_t buffer_fill; // Number of valid bytes in buffer
+	size_t buffer_pos; // Read position relative to buffer start, may exceed buffer_fill after seek
+	FSIZE_t buffer_offset; // File offset of buffer start, always chunk-aligned
+} stream_t;
+
+int stream_open(stream_t *stream, const char *path);
+
+/* Takes over a file opened beforehand, the file object mustn't be used or closed afterwards */
+int stream_attach(stream_t *stream, const FIL *file);
+
+size_t stream_read(stream_t *stream, void *buffer, size_t size);
+int stream_seek(stream_t *stream, FSIZE_t offset);
+
+FSIZE_t stream_tell(const stream_t *stream);
+FSIZE_t stream_size(const stream_t *stream);
+
+void stream_close(stream_t *stream);
+
+#endif /* STREAM_H_ */